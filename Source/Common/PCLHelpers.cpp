@@ -9,20 +9,21 @@
 */
 
 #include "PCLHelpers.h"
+#include "ParallelHelpers.h"
 
-Cluster::Cluster(int id, CloudPtr cloud) :
+Cluster::Cluster(int id, ConstCloudPtr cloud) :
 	id(id),
 	cloud(cloud)
 {
 	state = ENTERED;
-	if (cloud == nullptr) cloud.reset(new Cloud());
+	if (this->cloud == nullptr) this->cloud = getEmptyCloud();
 	lastUpdateTime = Time::getMillisecondCounterHiRes() / 1000.0;
 }
 
 Cluster::Cluster(std::shared_ptr<Cluster>& other)
 {
-	cloud.reset(new Cloud());
-	pcl::copyPointCloud(*other->cloud, *cloud); //simple reaffectation ? may cause problem in the node chain
+	cloud = other->cloud; //points are never modified in place, sharing them is safe
+	cloudSegments = other->cloudSegments;
 
 	id = other->id;
 	age = other->age;
@@ -45,7 +46,8 @@ void Cluster::update(std::shared_ptr<Cluster> newData)
 	double curT = Time::getMillisecondCounterHiRes() / 1000.0;
 	double delta = curT - lastUpdateTime;
 
-	pcl::copyPointCloud(*newData->cloud, *cloud);
+	cloud = newData->cloud;
+	cloudSegments = newData->cloudSegments;
 
 	age += delta;
 
@@ -65,12 +67,226 @@ void Cluster::update(std::shared_ptr<Cluster> newData)
 	state = UPDATED;
 }
 
+ConstCloudPtr Cluster::getCloud() const
+{
+	if (cloudSegments != nullptr) return cloudSegments->getCloud();
+	return cloud;
+}
+
+int Cluster::getNumPoints() const
+{
+	if (cloudSegments != nullptr) return cloudSegments->getNumPoints();
+	return (int)cloud->size();
+}
+
+void Cluster::appendPointsTo(CloudSegments& segments) const
+{
+	if (cloudSegments == nullptr)
+	{
+		segments.add(cloud);
+		return;
+	}
+
+	cloudSegments->appendTo(segments);
+}
+
+void Cluster::setCloud(ConstCloudPtr newCloud)
+{
+	cloud = newCloud != nullptr ? newCloud : getEmptyCloud();
+	cloudSegments.reset();
+}
+
+void Cluster::setCloudSegments(CloudSegmentsPtr segments)
+{
+	//a single segment is used as is
+	if (segments == nullptr || segments->getNumSegments() <= 1)
+	{
+		setCloud(segments != nullptr ? segments->getCloud() : nullptr);
+		return;
+	}
+
+	cloud.reset();
+	cloudSegments = segments;
+}
+
+CloudPtr Cluster::editCloud()
+{
+	CloudPtr result(new Cloud(*getCloud()));
+	setCloud(result);
+	return result;
+}
+
+ConstCloudPtr Cluster::getEmptyCloud()
+{
+	static ConstCloudPtr emptyCloud(new Cloud());
+	return emptyCloud;
+}
+
+void CloudSegments::add(ConstCloudPtr cloud)
+{
+	if (cloud == nullptr || cloud->empty()) return;
+	segments.add(cloud);
+	numPoints += (int)cloud->size();
+}
+
+void CloudSegments::appendTo(CloudSegments& other) const
+{
+	for (auto& s : segments) other.add(s);
+}
+
+ConstCloudPtr CloudSegments::getCloud() const
+{
+	if (segments.size() == 1) return segments[0];
+	if (segments.isEmpty()) return Cluster::getEmptyCloud();
+
+	GenericScopedLock lock(concatLock);
+	if (concatenated == nullptr)
+	{
+		CloudPtr result(new Cloud());
+		result->reserve(numPoints);
+		for (auto& s : segments) *result += *s;
+		concatenated = result;
+	}
+
+	return concatenated;
+}
+
+void PointGrid::build(CloudPtr c)
+{
+	cloud = c;
+	cellRanges.clear();
+	sortedIndices.clear();
+	if (cloud == nullptr) return;
+
+	const int numPoints = (int)cloud->size();
+	std::vector<int64> keys(numPoints);
+	sortedIndices.reserve(numPoints);
+
+	for (int i = 0; i < numPoints; i++)
+	{
+		const PPoint& p = cloud->points[i];
+		if (!pcl::isFinite(p)) continue;
+		keys[i] = getCellKey(getCellCoord(p.x), getCellCoord(p.y), getCellCoord(p.z));
+		sortedIndices.push_back(i);
+	}
+
+	std::sort(sortedIndices.begin(), sortedIndices.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+
+	int start = 0;
+	for (int i = 1; i <= (int)sortedIndices.size(); i++)
+	{
+		if (i < (int)sortedIndices.size() && keys[sortedIndices[i]] == keys[sortedIndices[start]]) continue;
+		cellRanges.set(keys[sortedIndices[start]], Range<int>(start, i));
+		start = i;
+	}
+}
+
+void PointGrid::getPointsInBox(const Vector3D<float>& boxMin, const Vector3D<float>& boxMax, Cloud& result) const
+{
+	result.clear();
+	if (cloud == nullptr) return;
+
+	for (int x = getCellCoord(boxMin.x); x <= getCellCoord(boxMax.x); x++)
+	{
+		for (int y = getCellCoord(boxMin.y); y <= getCellCoord(boxMax.y); y++)
+		{
+			for (int z = getCellCoord(boxMin.z); z <= getCellCoord(boxMax.z); z++)
+			{
+				int64 key = getCellKey(x, y, z);
+				if (!cellRanges.contains(key)) continue;
+
+				Range<int> r = cellRanges[key];
+				for (int i = r.getStart(); i < r.getEnd(); i++)
+				{
+					const PPoint& p = cloud->points[sortedIndices[i]];
+					if (p.x < boxMin.x || p.y < boxMin.y || p.z < boxMin.z || p.x > boxMax.x || p.y > boxMax.y || p.z > boxMax.z) continue;
+					result.push_back(p);
+				}
+			}
+		}
+	}
+
+	result.width = (uint32_t)result.size();
+	result.height = 1;
+	result.is_dense = true;
+}
+
+int64 PointGrid::getCellKey(int x, int y, int z) const
+{
+	const int64 offset = 1 << 20;
+	return ((x + offset) << 42) | ((y + offset) << 21) | (z + offset);
+}
+
+CloudPtr CloudPool::getCloud(int width, int height)
+{
+	GenericScopedLock lock(poolLock);
+
+	CloudPtr result;
+	for (auto& c : clouds)
+	{
+		if (c.use_count() == 1) //only referenced by the pool
+		{
+			result = c;
+			break;
+		}
+	}
+
+	if (result == nullptr)
+	{
+		result.reset(new Cloud(width, height));
+		if (clouds.size() < maxClouds) clouds.add(result);
+		return result;
+	}
+
+	if ((int)result->width != width || (int)result->height != height)
+	{
+		result->points.resize(width * height);
+		result->width = width;
+		result->height = height;
+	}
+
+	return result;
+}
+
+void CloudPool::clear()
+{
+	GenericScopedLock lock(poolLock);
+	clouds.clear();
+}
+
+CloudPtr CloudTransformer::transform(const CloudPtr& source, const Eigen::Affine3f& t, bool inPlace)
+{
+	CloudPtr result = source;
+	if (!inPlace)
+	{
+		result = pool.getCloud(source->width, source->height);
+		result->header = source->header;
+		result->is_dense = source->is_dense;
+		result->sensor_origin_ = source->sensor_origin_;
+		result->sensor_orientation_ = source->sensor_orientation_;
+	}
+
+	const int numPoints = (int)source->size();
+	const PPoint* src = source->points.data();
+	PPoint* dst = result->points.data();
+	const Eigen::Matrix4f m = t.matrix();
+
+	const int blockSize = 8192;
+	pleiades::parallelFor((numPoints + blockSize - 1) / blockSize, [&](int block)
+		{
+			int start = block * blockSize;
+			pleiades::transformPoints(src + start, dst + start, jmin(blockSize, numPoints - start), m);
+		});
+
+	return result;
+}
+
 namespace pleiades
 {
 	void copyClusters(Array<ClusterPtr>& source, Array<ClusterPtr>& dest)
 	{
 		dest.clear();
-		for (int i = 0; i < source.size(); i++) dest.add(ClusterPtr(new Cluster(*source[i])));
+		for (int i = 0; i < source.size(); i++) dest.add(ClusterPtr(new Cluster(*source[i]))); //points are shared
 	}
 
 	Eigen::Quaternionf euler2Quaternion(const float roll, const float pitch, const float yaw)
@@ -83,5 +299,25 @@ namespace pleiades
 
 		return q;
 	}
+
+	Eigen::Affine3f makeTransform(const Vector3D<float>& translate, const Vector3D<float>& rotate, const Vector3D<float>& scale)
+	{
+		Eigen::Affine3f transform = Eigen::Affine3f::Identity();
+		transform.translate(Eigen::Vector3f(translate.x, translate.y, translate.z));
+		transform.rotate(euler2Quaternion(rotate.z, rotate.x, rotate.y));
+		transform.scale(Eigen::Vector3f(scale.x, scale.y, scale.z));
+		return transform;
+	}
+
+	void transformPoints(const PPoint* source, PPoint* dest, int numPoints, const Eigen::Matrix4f& m)
+	{
+		//points are 16 bytes aligned, each one is a single 4x4 by 4 product on SIMD registers
+		for (int i = 0; i < numPoints; i++)
+		{
+			Eigen::Vector4f p = source[i].getVector4fMap();
+			p[3] = 1;
+			dest[i].getVector4fMap() = m * p;
+		}
+	}
 }
 
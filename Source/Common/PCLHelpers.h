@@ -31,17 +31,44 @@
 typedef pcl::PointXYZ PPoint;
 typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
 typedef Cloud::Ptr CloudPtr;
+typedef Cloud::ConstPtr ConstCloudPtr;
+typedef Eigen::Transform<float, 3, Eigen::Affine, Eigen::DontAlign> UnalignedAffine3f; //safe as a member of heap allocated nodes
 typedef pcl::PointIndices PIndices;
 
+//Several clouds seen as one, only concatenated the first time contiguous points are asked for. Can be read from multiple threads
+class CloudSegments
+{
+public:
+	CloudSegments() : numPoints(0) {}
+
+	void add(ConstCloudPtr cloud);
+	void appendTo(CloudSegments& other) const; //adds each segment, never concatenates
+	int getNumSegments() const { return segments.size(); }
+	int getNumPoints() const { return numPoints; }
+	ConstCloudPtr getCloud() const;
+
+private:
+	Array<ConstCloudPtr> segments;
+	int numPoints;
+	mutable ConstCloudPtr concatenated;
+	mutable CriticalSection concatLock;
+};
+
+typedef std::shared_ptr<const CloudSegments> CloudSegmentsPtr;
+
+//Cluster values are copied freely, the points are an immutable payload shared between all the copies.
+//The payload is either a single cloud, or segments that are only concatenated when getCloud is called.
+//To change the points, use setCloud with a new cloud or editCloud to get a private copy
 class Cluster
 {
 public:
-	Cluster(int id, CloudPtr cloud);
+	Cluster(int id, ConstCloudPtr cloud);
 	Cluster(std::shared_ptr<Cluster>& other);
 	virtual ~Cluster() {}
 
 	int id = 0;
-	CloudPtr cloud;
+	ConstCloudPtr cloud; //null when the points are segmented, read points with getCloud
+	CloudSegmentsPtr cloudSegments;
 
 	float age = 0;
 	float ghostAge = 0;
@@ -63,14 +90,112 @@ public:
 	State state;
 
 	void update(std::shared_ptr<Cluster> newData);
+
+	ConstCloudPtr getCloud() const;
+	int getNumPoints() const;
+	void appendPointsTo(CloudSegments& segments) const; //without concatenating
+
+	void setCloud(ConstCloudPtr newCloud);
+	void setCloudSegments(CloudSegmentsPtr segments);
+	CloudPtr editCloud(); //copy on write, the returned cloud becomes the payload and must be filled before the cluster is sent
+
+	static ConstCloudPtr getEmptyCloud();
 };
 
 typedef std::shared_ptr<Cluster> ClusterPtr;
 
+//Uniform grid over a cloud, built once and then queried many times with boxes. Read-only queries can run on multiple threads
+class PointGrid
+{
+public:
+	PointGrid(float cellSize = .2f) : cellSize(cellSize) {}
+
+	float cellSize;
+	CloudPtr cloud;
+	std::vector<int> sortedIndices; //point indices grouped by cell
+	HashMap<int64, Range<int>> cellRanges; //range in sortedIndices for each non-empty cell
+
+	void build(CloudPtr cloud);
+	void getPointsInBox(const Vector3D<float>& boxMin, const Vector3D<float>& boxMax, Cloud& result) const;
+
+	int64 getCellKey(int x, int y, int z) const;
+	int getCellCoord(float v) const { return (int)std::floor(v / cellSize); }
+};
+
+//Recycles clouds once every node down the chain has released them, to avoid allocating a new cloud each frame
+class CloudPool
+{
+public:
+	CloudPool(int maxClouds = 8) : maxClouds(maxClouds) {}
+
+	int maxClouds;
+	Array<CloudPtr> clouds;
+	SpinLock poolLock;
+
+	CloudPtr getCloud(int width, int height);
+	void clear();
+};
+
+//Transforms whole clouds with one matrix multiply per point, spread over the worker pool.
+//Chains of transforms are composed into a single matrix by the caller before touching the points
+class CloudTransformer
+{
+public:
+	CloudTransformer() {}
+
+	CloudPool pool;
+
+	//In place when the caller owns the points (see Node::canWriteInputInPlace), otherwise into a pooled cloud of the same size
+	CloudPtr transform(const CloudPtr& source, const Eigen::Affine3f& t, bool inPlace);
+};
+
 namespace pleiades
 {
 	void copyClusters(Array<ClusterPtr>& source, Array<ClusterPtr>& dest);
 
 	Eigen::Quaternionf euler2Quaternion(const float roll, const float pitch, const float yaw);
+
+	//Translate, then rotate (euler angles in radians, as x y z), then scale
+	Eigen::Affine3f makeTransform(const Vector3D<float>& translate, const Vector3D<float>& rotate, const Vector3D<float>& scale);
+
+	//Points of source for which keep(p) is true, into dest as an unorganized cloud. Used instead of erase when source is shared
+	template<typename F>
+	void copyPointsIf(const Cloud& source, Cloud& dest, F keep)
+	{
+		dest.points.resize(source.size());
+		size_t numKept = 0;
+		for (auto& p : source.points) if (keep(p)) dest.points[numKept++] = p;
+		dest.points.resize(numKept);
+		dest.width = (uint32_t)numKept;
+		dest.height = 1;
+		dest.header = source.header;
+		dest.is_dense = source.is_dense;
+	}
+
+	//source and dest can be the same
+	void transformPoints(const PPoint* source, PPoint* dest, int numPoints, const Eigen::Matrix4f& m);
+
+	//Fills an organized cloud of ceil(width/downSample) x ceil(height/downSample) from interleaved xyz camera points,
+	//each component multiplied by scale (unit conversion and axis flips)
+	template<typename T>
+	void pointsToCloud(const T* points, int width, int height, int downSample, const Eigen::Array4f& scale, Cloud& cloud)
+	{
+		const int downW = (width + downSample - 1) / downSample;
+		const int downH = (height + downSample - 1) / downSample;
+		jassert((int)cloud.width == downW && (int)cloud.height == downH);
+
+		const int colStride = 3 * downSample;
+		const int rowStride = 3 * width * downSample;
+
+		for (int y = 0; y < downH; y++)
+		{
+			const T* src = points + y * rowStride;
+			PPoint* dst = &cloud.points[y * downW];
+			for (int x = 0; x < downW; x++, src += colStride, dst++)
+			{
+				dst->getArray4fMap() = Eigen::Array4f((float)src[0], (float)src[1], (float)src[2], 1.0f) * scale;
+			}
+		}
+	}
 }
 
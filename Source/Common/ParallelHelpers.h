@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+	ParallelHelpers.h
+	Created: 18 Oct 2026 6:37:46am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+#pragma once
+
+namespace pleiades
+{
+	//Pool shared by the nodes for data-parallel work inside a single process() call
+	inline ThreadPool& getWorkerPool()
+	{
+		static ThreadPool pool(jmax(SystemStats::getNumCpus() - 1, 1));
+		return pool;
+	}
+
+	//Calls func(i) for every i in [0, num), spread over the worker pool. The calling thread takes part and the call returns when all are done.
+	//Below minPerJob items per job, it's not worth waking threads and everything runs on the calling thread.
+	inline void parallelFor(int num, const std::function<void(int)>& func, int minPerJob = 1)
+	{
+		if (num <= 0) return;
+
+		ThreadPool& pool = getWorkerPool();
+		int numJobs = jmin(pool.getNumThreads(), num / jmax(minPerJob, 1) - 1);
+		if (numJobs <= 0)
+		{
+			for (int i = 0; i < num; i++) func(i);
+			return;
+		}
+
+		//shared with the jobs, the last one may still be signalling after the caller has returned
+		struct SharedState
+		{
+			Atomic<int> nextIndex;
+			Atomic<int> remainingJobs;
+			WaitableEvent jobsDone;
+		};
+
+		auto state = std::make_shared<SharedState>();
+		state->remainingJobs = numJobs;
+
+		//func is only called before a job's decrement, so it can stay a reference to the caller's functor
+		const std::function<void(int)>* f = &func;
+
+		for (int j = 0; j < numJobs; j++)
+		{
+			pool.addJob([state, f, num]()
+				{
+					for (int i = state->nextIndex++; i < num; i = state->nextIndex++) (*f)(i);
+					if (--state->remainingJobs == 0) state->jobsDone.signal();
+				});
+		}
+
+		for (int i = state->nextIndex++; i < num; i = state->nextIndex++) func(i);
+
+		//jobs use func until they decrement, wait for the last one even if they had nothing left to do
+		state->jobsDone.wait(-1);
+	}
+}
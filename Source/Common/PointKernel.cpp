@@ -0,0 +1,169 @@
+/*
+  ==============================================================================
+
+	PointKernel.cpp
+	Created: 18 Oct 2026 7:01:15am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+PointKernel::PointKernel() :
+	pool(4)
+{
+}
+
+void PointKernel::clear()
+{
+	stages.clear();
+	boxes.clear();
+}
+
+void PointKernel::addTransform(const Eigen::Affine3f& t)
+{
+	if (!stages.empty() && stages.back().type == Stage::TRANSFORM)
+	{
+		stages.back().matrix = t.matrix() * stages.back().matrix;
+		return;
+	}
+
+	Stage s;
+	s.type = Stage::TRANSFORM;
+	s.matrix = t.matrix();
+	stages.push_back(s);
+}
+
+void PointKernel::addCrop(const std::vector<Box>& cropBoxes, bool removeInvalid, bool keepOrganized)
+{
+	Stage s;
+	s.type = Stage::CROP;
+	s.firstBox = (int)boxes.size();
+	s.numBoxes = (int)cropBoxes.size();
+	s.removeInvalid = removeInvalid;
+	s.keepOrganized = keepOrganized;
+	boxes.insert(boxes.end(), cropBoxes.begin(), cropBoxes.end());
+	stages.push_back(s);
+}
+
+void PointKernel::addCleanUp(bool removeInfinite)
+{
+	Stage s;
+	s.type = Stage::CLEAN_UP;
+	s.removeInfinite = removeInfinite;
+	stages.push_back(s);
+}
+
+bool PointKernel::canRemovePoints() const
+{
+	for (auto& s : stages)
+	{
+		if (s.type == Stage::CLEAN_UP || (s.type == Stage::CROP && !s.keepOrganized)) return true;
+	}
+	return false;
+}
+
+CloudPtr PointKernel::run(const CloudPtr& source)
+{
+	const int numPoints = (int)source->size();
+	const bool compact = canRemovePoints();
+
+	//like the nodes it replaces, the result is only organized when no stage removes points
+	CloudPtr result = compact ? pool.getCloud(numPoints, 1) : pool.getCloud(source->width, source->height);
+	result->header = source->header;
+
+	const int blockSize = 8192;
+	const int numBlocks = (numPoints + blockSize - 1) / blockSize;
+	blockCounts.resize(numBlocks);
+
+	const PPoint* src = source->points.data();
+	PPoint* dst = result->points.data();
+
+	pleiades::parallelFor(numBlocks, [&](int block)
+		{
+			int start = block * blockSize;
+			blockCounts[block] = processBlock(src + start, dst + start, jmin(blockSize, numPoints - start), compact);
+		});
+
+	//each block was written at its own position, close the gaps
+	int numKept = numPoints;
+	if (compact)
+	{
+		numKept = 0;
+		for (int b = 0; b < numBlocks; b++)
+		{
+			int start = b * blockSize;
+			if (numKept != start) memmove(dst + numKept, dst + start, blockCounts[b] * sizeof(PPoint));
+			numKept += blockCounts[b];
+		}
+
+		result->points.resize(numKept);
+		result->width = numKept;
+		result->height = 1;
+	}
+
+	bool isDense = true;
+	for (int i = 0; i < numKept && isDense; i++) isDense = pcl::isFinite(result->points[i]);
+	result->is_dense = isDense;
+
+	return result;
+}
+
+int PointKernel::processBlock(const PPoint* source, PPoint* dest, int numPoints, bool compact) const
+{
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	int numKept = 0;
+
+	for (int i = 0; i < numPoints; i++)
+	{
+		Eigen::Vector4f p = source[i].getVector4fMap();
+		p[3] = 1;
+		bool removed = false;
+
+		for (auto& s : stages)
+		{
+			switch (s.type)
+			{
+			case Stage::TRANSFORM:
+				p = s.matrix * p;
+				break;
+
+			case Stage::CROP:
+			{
+				bool keep = false;
+				if (!s.removeInvalid || (std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2])))
+				{
+					keep = s.numBoxes == 0 || boxes[s.firstBox].mode != BOX_ADD;
+					for (int b = s.firstBox; b < s.firstBox + s.numBoxes; b++)
+					{
+						Eigen::Vector4f local = boxes[b].worldToBox * p;
+						bool inside = (local.head<3>().array().abs() <= 1.0f).all();
+						switch (boxes[b].mode)
+						{
+						case BOX_ADD: keep |= inside; break;
+						case BOX_SUBTRACT: keep &= !inside; break;
+						case BOX_INTERSECT: keep &= inside; break;
+						}
+					}
+				}
+
+				if (keep) break;
+				if (s.keepOrganized) p = Eigen::Vector4f(nan, nan, nan, 1);
+				else removed = true;
+			}
+			break;
+
+			case Stage::CLEAN_UP:
+				if ((p[0] == 0 && p[1] == 0 && p[2] == 0) || (s.removeInfinite && (std::isinf(p[0]) || std::isinf(p[1]) || std::isinf(p[2])))) removed = true;
+				break;
+			}
+
+			if (removed) break;
+		}
+
+		if (removed) continue;
+		dest[compact ? numKept : i].getVector4fMap() = p;
+		numKept++;
+	}
+
+	return numKept;
+}
@@ -0,0 +1,66 @@
+/*
+  ==============================================================================
+
+	PointKernel.h
+	Created: 18 Oct 2026 7:01:15am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "PCLHelpers.h"
+
+//Point-wise stages of several nodes, run as a single pass over the points.
+//Each point goes through all the stages in order, the result is the same as running the nodes one after the other
+class PointKernel
+{
+public:
+	PointKernel();
+
+	enum BoxMode { BOX_ADD, BOX_SUBTRACT, BOX_INTERSECT }; //same order as the crop box node modes
+
+	struct Box
+	{
+		Eigen::Matrix<float, 4, 4, Eigen::DontAlign> worldToBox; //maps the box to [-1, 1] on each axis
+		BoxMode mode;
+	};
+
+	struct Stage
+	{
+		enum Type { TRANSFORM, CROP, CLEAN_UP };
+		Type type;
+
+		Eigen::Matrix<float, 4, 4, Eigen::DontAlign> matrix; //transform
+
+		//crop
+		int firstBox = 0;
+		int numBoxes = 0;
+		bool removeInvalid = false; //non finite points
+		bool keepOrganized = false; //cropped points become NaN instead of being removed
+
+		bool removeInfinite = false; //clean up, points at 0,0,0 are always removed
+	};
+
+	std::vector<Stage> stages;
+	std::vector<Box> boxes;
+	CloudPool pool;
+
+	void clear();
+
+	//consecutive transforms are composed into a single matrix
+	void addTransform(const Eigen::Affine3f& t);
+	void addCrop(const std::vector<Box>& cropBoxes, bool removeInvalid, bool keepOrganized);
+	void addCleanUp(bool removeInfinite);
+
+	bool isEmpty() const { return stages.empty(); }
+	bool canRemovePoints() const;
+
+	CloudPtr run(const CloudPtr& source);
+
+private:
+	std::vector<int> blockCounts;
+
+	int processBlock(const PPoint* source, PPoint* dest, int numPoints, bool compact) const;
+};
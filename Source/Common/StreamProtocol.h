@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+	StreamProtocol.h
+	Created: 18 Oct 2026 6:44:18am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//Binary messages shared by the websocket output and source nodes. All values are little endian.
+//	Cloud           : byte type, int 1000 + id, then float x y z per point
+//	Quantized cloud : byte type, int 1000 + id, float step, then int16 x y z per point, in steps
+//	Cluster batch   : byte type, byte quantized, float step, int numClusters, then for each cluster
+//	                  int id, int state, float centroid[3] velocity[3] boxMin[3] boxMax[3], int numPoints, points
+//	Cluster deltas  : byte type, byte version, byte isKeyframe, float step, int numRecords, then for each record
+//	                  byte kind, varint id, and depending on the kind
+//	                  - full   : varint state, varint centroid[3] velocity[3] boxMin[3] boxMax[3] in steps, varint numPoints, int16 points
+//	                  - update : byte changedFields, the changed values as differences with the last ones sent, varint numPoints, int16 points
+//	                  - left   : nothing, the cluster is gone
+//	                  A keyframe only has full records and replaces all the clusters the receiver knows.
+//	Varints are zigzag encoded, so small negative values stay small.
+namespace StreamProtocol
+{
+	enum DataType
+	{
+		CloudType = 0,
+		ClusterType = 1,
+		DebugBoxType = 2,
+		DebugPointType = 3,
+		DebugLineType = 4,
+		DebugPlaneType = 5,
+		CloudQuantizedType = 6,
+		ClusterBatchType = 7,
+		ClusterDeltaType = 8
+	};
+
+	const int deltaVersion = 1;
+	const int deltaHeaderSize = 1 + 1 + 4 + 4; //version, isKeyframe, step, numRecords, after the type byte
+	enum DeltaRecordKind { RecordFull = 0, RecordUpdate = 1, RecordLeft = 2 };
+	enum DeltaFields { StateChanged = 1, CentroidChanged = 2, VelocityChanged = 4, BoxChanged = 8 };
+
+	const float quantizedStep = .001f; //1mm, +/- 32m range with int16
+	const int clusterHeaderSize = 4 + 4 + 12 * 4; //id, state, centroid, velocity, box
+
+	inline int getPointSize(bool quantized) { return quantized ? 6 : 12; }
+	inline int getNumSentPoints(int numPoints, int downSample) { return (numPoints + downSample - 1) / downSample; }
+
+	inline uint8* writeByte(uint8* d, uint8 v) { *d = v; return d + 1; }
+	inline uint8* writeInt(uint8* d, int v) { uint32 le = ByteOrder::swapIfBigEndian((uint32)v); memcpy(d, &le, 4); return d + 4; }
+	inline uint8* writeFloat(uint8* d, float v) { uint32 bits; memcpy(&bits, &v, 4); return writeInt(d, (int)bits); }
+
+	inline uint8* writeVarint(uint8* d, int value)
+	{
+		uint32 v = ((uint32)value << 1) ^ (uint32)(value >> 31);
+		while (v >= 0x80)
+		{
+			*d++ = (uint8)(v | 0x80);
+			v >>= 7;
+		}
+		*d++ = (uint8)v;
+		return d;
+	}
+
+	inline const uint8* readVarint(const uint8* s, const uint8* end, int& value)
+	{
+		uint32 v = 0;
+		for (int shift = 0; s < end && shift < 35; shift += 7)
+		{
+			uint8 b = *s++;
+			v |= (uint32)(b & 0x7f) << shift;
+			if ((b & 0x80) == 0) break;
+		}
+		value = (int)(v >> 1) ^ -(int)(v & 1);
+		return s;
+	}
+
+	inline const uint8* readInt(const uint8* s, int& v) { uint32 le; memcpy(&le, s, 4); v = (int)ByteOrder::swapIfBigEndian(le); return s + 4; }
+	inline const uint8* readFloat(const uint8* s, float& v) { int bits; s = readInt(s, bits); memcpy(&v, &bits, 4); return s; }
+
+	//one of every downSample points, copied straight from the PPoint array
+	inline uint8* writePoints(uint8* d, const PPoint* points, int numPoints, int downSample, bool quantized, float step = quantizedStep)
+	{
+		if (quantized)
+		{
+			const float invStep = 1.0f / step;
+			for (int i = 0; i < numPoints; i += downSample)
+			{
+				const PPoint& p = points[i];
+				int16 q[3] = {
+					(int16)jlimit(-32767, 32767, roundToInt(p.x * invStep)),
+					(int16)jlimit(-32767, 32767, roundToInt(p.y * invStep)),
+					(int16)jlimit(-32767, 32767, roundToInt(p.z * invStep))
+				};
+#if JUCE_BIG_ENDIAN
+				for (auto& v : q) v = (int16)ByteOrder::swap((uint16)v);
+#endif
+				memcpy(d, q, 6);
+				d += 6;
+			}
+			return d;
+		}
+
+		for (int i = 0; i < numPoints; i += downSample)
+		{
+#if JUCE_BIG_ENDIAN
+			for (int c = 0; c < 3; c++) d = writeFloat(d, points[i].data[c]);
+#else
+			memcpy(d, points[i].data, 12); //x y z are contiguous in a PPoint, only the padding is skipped
+			d += 12;
+#endif
+		}
+		return d;
+	}
+
+	inline const uint8* readPoints(const uint8* s, PPoint* points, int numPoints, bool quantized, float step = quantizedStep)
+	{
+		if (quantized)
+		{
+			for (int i = 0; i < numPoints; i++)
+			{
+				int16 q[3];
+				memcpy(q, s, 6);
+#if JUCE_BIG_ENDIAN
+				for (auto& v : q) v = (int16)ByteOrder::swap((uint16)v);
+#endif
+				points[i] = PPoint(q[0] * step, q[1] * step, q[2] * step);
+				s += 6;
+			}
+			return s;
+		}
+
+		for (int i = 0; i < numPoints; i++)
+		{
+#if JUCE_BIG_ENDIAN
+			for (int c = 0; c < 3; c++) s = readFloat(s, points[i].data[c]);
+			points[i].data[3] = 1;
+#else
+			memcpy(points[i].data, s, 12);
+			points[i].data[3] = 1;
+			s += 12;
+#endif
+		}
+		return s;
+	}
+
+	//header values of a cluster as integer steps, deltas are computed on these so the receiver never drifts
+	struct ClusterState
+	{
+		static const int numValues = 12;
+
+		int state = 0;
+		int values[numValues] = {}; //centroid, velocity, box min, box max
+
+		static ClusterState fromCluster(const Cluster& c, float step)
+		{
+			ClusterState s;
+			s.state = (int)c.state;
+			const Vector3D<float>* vectors[4] = { &c.centroid, &c.velocity, &c.boundingBoxMin, &c.boundingBoxMax };
+			for (int i = 0; i < 4; i++)
+			{
+				s.values[i * 3] = roundToInt(vectors[i]->x / step);
+				s.values[i * 3 + 1] = roundToInt(vectors[i]->y / step);
+				s.values[i * 3 + 2] = roundToInt(vectors[i]->z / step);
+			}
+			return s;
+		}
+
+		void applyTo(Cluster& c, float step) const
+		{
+			c.state = (Cluster::State)state;
+			Vector3D<float>* vectors[4] = { &c.centroid, &c.velocity, &c.boundingBoxMin, &c.boundingBoxMax };
+			for (int i = 0; i < 4; i++) *vectors[i] = Vector3D<float>(values[i * 3] * step, values[i * 3 + 1] * step, values[i * 3 + 2] * step);
+		}
+
+		int getChangedFields(const ClusterState& previous) const
+		{
+			int fields = state != previous.state ? StateChanged : 0;
+			if (!rangesEqual(previous, 0, 3)) fields |= CentroidChanged;
+			if (!rangesEqual(previous, 3, 6)) fields |= VelocityChanged;
+			if (!rangesEqual(previous, 6, 12)) fields |= BoxChanged;
+			return fields;
+		}
+
+		bool rangesEqual(const ClusterState& other, int start, int end) const
+		{
+			for (int i = start; i < end; i++) if (values[i] != other.values[i]) return false;
+			return true;
+		}
+	};
+
+	//first and last value index of each field in ClusterState::values
+	inline Range<int> getFieldRange(int field)
+	{
+		switch (field)
+		{
+		case CentroidChanged: return { 0, 3 };
+		case VelocityChanged: return { 3, 6 };
+		case BoxChanged: return { 6, 12 };
+		default: return {};
+		}
+	}
+}
@@ -0,0 +1,74 @@
+/*
+  ==============================================================================
+
+	TripleBuffer.h
+	Created: 18 Oct 2026 6:35:59am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//Lock-free handoff of frames between one producer thread (camera capture) and one consumer thread (node process).
+//The producer always has a buffer to write into and never waits, the consumer always gets the newest complete frame.
+template<class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() :
+		state(2),
+		writeIndex(0),
+		readIndex(1)
+	{
+	}
+
+	//producer side
+	T& getWriteBuffer() { return buffers[writeIndex]; }
+
+	void publish()
+	{
+		int old = state.exchange(writeIndex | freshBit);
+		writeIndex = old & indexMask;
+	}
+
+	//consumer side, returns true if a newer frame has been swapped in since last fetch
+	bool fetch()
+	{
+		if ((state.get() & freshBit) == 0) return false;
+		int old = state.exchange(readIndex);
+		readIndex = old & indexMask;
+		return true;
+	}
+
+	T& getReadBuffer() { return buffers[readIndex]; }
+
+private:
+	static const int indexMask = 3;
+	static const int freshBit = 4;
+
+	T buffers[3];
+	Atomic<int> state; //index of the middle buffer, with freshBit set when it holds a frame the consumer hasn't seen
+	int writeIndex;
+	int readIndex;
+
+	JUCE_DECLARE_NON_COPYABLE(TripleBuffer)
+};
+
+//Interleaved xyz points as given by the camera SDKs
+template<typename T>
+struct PointsFrame
+{
+	Array<T> xyz;
+	int width = 0;
+	int height = 0;
+
+	void setSize(int w, int h)
+	{
+		width = w;
+		height = h;
+		xyz.resize(w * h * 3);
+	}
+
+	bool isEmpty() const { return width == 0 || height == 0; }
+};
@@ -12,6 +12,7 @@
 NodeConnectionSlot::NodeConnectionSlot(Node* node, bool isInput, String name, NodeConnectionType type) :
 	isInput(isInput),
 	processOnReceive(true),
+	index(-1),
 	name(name),
 	type(type),
 	node(node)
@@ -59,5 +60,5 @@ bool NodeConnectionSlot::hasConnectedNodeProcessed(bool trueIfEmpty)
 {
 	if (isEmpty()) return trueIfEmpty;
 	if (!connections[0]->enabled->boolValue() || connections[0]->source == nullptr || connections[0]->source->node == nullptr) return trueIfEmpty;
-	return connections[0]->source->node->hasProcessed;
+	return connections[0]->source->node->hasProcessedFrame(node->processingFrameID);
 }
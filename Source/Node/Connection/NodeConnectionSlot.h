@@ -23,6 +23,7 @@ public:
 
 	bool isInput;
 	bool processOnReceive;
+	int index; //position in the node's inSlots or outSlots, used to address slot data
 
 	String name;
 	NodeConnectionType type;
@@ -39,3 +40,64 @@ public:
 
 	bool isEmpty() const { return connections.size() == 0; }
 };
+
+//Preallocated data for all the input slots of a node, addressed by slot index instead of hashing
+template<class T>
+class SlotData
+{
+public:
+	void setNumSlots(int numSlots)
+	{
+		GenericScopedLock lock(writeLock);
+		values.resize(numSlots);
+		hasValue.resize(numSlots);
+	}
+
+	const T& operator[](NodeConnectionSlot* slot) const
+	{
+		jassert(slot != nullptr && isPositiveAndBelow(slot->index, values.size()));
+		return values.getReference(slot->index);
+	}
+
+	bool contains(NodeConnectionSlot* slot) const { return slot != nullptr && hasValue[slot->index]; }
+
+	void set(NodeConnectionSlot* slot, const T& value)
+	{
+		jassert(slot != nullptr && isPositiveAndBelow(slot->index, values.size()));
+		GenericScopedLock lock(writeLock); //only contended when a slot has multiple connections
+		values.set(slot->index, value);
+		hasValue.set(slot->index, true);
+	}
+
+	void clear()
+	{
+		for (int i = 0; i < values.size(); i++)
+		{
+			if (!hasValue[i]) continue;
+			values.set(i, T());
+			hasValue.set(i, false);
+		}
+	}
+
+	void swapWith(SlotData& other)
+	{
+		values.swapWith(other.values);
+		hasValue.swapWith(other.hasValue);
+	}
+
+	//only overwrites the slots that have a value in the source
+	void setAll(const SlotData& other)
+	{
+		for (int i = 0; i < other.values.size(); i++)
+		{
+			if (!other.hasValue[i]) continue;
+			values.set(i, other.values[i]);
+			hasValue.set(i, true);
+		}
+	}
+
+private:
+	Array<T> values;
+	Array<bool> hasValue;
+	SpinLock writeLock;
+};
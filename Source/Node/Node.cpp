@@ -19,8 +19,18 @@ Node::Node(StringRef name, NodeType type, var params) :
 	lastProcessTime(0),
 	deltaTime(0),
 	processTimeMS(0),
+	processingFrameID(-1),
+	fusedInto(nullptr),
+	fusedConsumer(nullptr),
+	inputStagesRunBy(nullptr),
 	nodeNotifier(5)
 {
+	for (int i = 0; i < maxPipelineDepth; i++)
+	{
+		frameSlotBuffers.add(new FrameSlotBuffers());
+		processedFrameIDs[i] = -1;
+	}
+
 	showWarningInUI = true;
 	logEnabled = addBoolParameter("Log", "If enabled, this will show log messages for this node", false);
 	showServerControls = addBoolParameter("Show Server Controls", "Show controls in web server", true);
@@ -91,6 +101,7 @@ void Node::process()
 
 	removeNextToProcess();
 	hasProcessed = true;
+	if (processingFrameID >= 0) processedFrameIDs[processingFrameID % maxPipelineDepth] = processingFrameID;
 }
 
 void Node::processInternalPassthrough()
@@ -119,6 +130,38 @@ void Node::resetForNextLoop()
 {
 	clearSlotMaps();
 	hasProcessed = false;
+	processingFrameID = -1;
+}
+
+bool Node::beginFrame(int64 frameID)
+{
+	GenericScopedLock lock(processLock);
+	resetForNextLoop();
+	processingFrameID = frameID;
+
+	FrameSlotBuffers* b = frameSlotBuffers[frameID % maxPipelineDepth];
+	GenericScopedLock bLock(b->lock);
+	if (b->frameID != frameID) return false;
+
+	slotCloudMap.swapWith(b->slotCloudMap);
+	slotClustersMap.swapWith(b->slotClustersMap);
+	slotMatrixMap.swapWith(b->slotMatrixMap);
+	slotVectorMap.swapWith(b->slotVectorMap);
+	slotIndicesMap.swapWith(b->slotIndicesMap);
+
+	//transforms and images are kept between frames, only overwrite the ones that were received
+	slotTransformMap.setAll(b->slotTransformMap);
+	slotImageMap.setAll(b->slotImageMap);
+
+	bool result = b->shouldProcess;
+	b->clear();
+	return result;
+}
+
+bool Node::hasProcessedFrame(int64 frameID)
+{
+	if (frameID < 0) return hasProcessed;
+	return processedFrameIDs[frameID % maxPipelineDepth] == frameID;
 }
 
 bool Node::isStartingNode()
@@ -137,54 +180,140 @@ void Node::onContainerParameterChangedInternal(Parameter* p)
 	if (p == enabled) notifyServerControlsUpdated();
 }
 
+CloudPtr Node::runPointChain(const CloudPtr& source)
+{
+	if (pointKernel == nullptr) pointKernel.reset(new PointKernel());
+
+	pointKernel->clear();
+	for (auto& n : fusedNodes) n->addPointStages(*pointKernel);
+	addPointStages(*pointKernel);
+	if (fusedConsumer != nullptr) fusedConsumer->addInputPointStages(*pointKernel);
+
+	return pointKernel->run(source);
+}
+
+bool Node::canWriteInputInPlace(NodeConnectionSlot* slot, const CloudPtr& cloud, int localRefs)
+{
+	//no sibling branch received this cloud, unless the sender forwarded its own input
+	if (!exclusiveInputs.contains(slot) || slot->connections.size() != 1) return false;
+
+	Node* sender = slot->connections[0]->source->node;
+	if (sender == nullptr || !sender->enabled->boolValue() || sender->isFusedIntoNext()) return false;
+
+	//nodes that forward their input or released it after reading it are counted here, the fence makes their reads visible before our writes
+	if (cloud.use_count() > localRefs) return false;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return true;
+}
+
 NodeConnectionSlot* Node::addSlot(StringRef name, bool isInput, NodeConnectionType t)
 {
 	jassert(getSlotWithName(name, isInput) == nullptr);
 	NodeConnectionSlot* s = new NodeConnectionSlot(this, isInput, name, t);
-	if (isInput) inSlots.add(s);
-	else outSlots.add(s);
+	if (isInput)
+	{
+		s->index = inSlots.size();
+		inSlots.add(s);
+
+		int numSlots = inSlots.size();
+		slotCloudMap.setNumSlots(numSlots);
+		slotClustersMap.setNumSlots(numSlots);
+		slotMatrixMap.setNumSlots(numSlots);
+		slotTransformMap.setNumSlots(numSlots);
+		slotVectorMap.setNumSlots(numSlots);
+		slotIndicesMap.setNumSlots(numSlots);
+		slotImageMap.setNumSlots(numSlots);
+		for (auto& b : frameSlotBuffers) b->setNumSlots(numSlots);
+	}
+	else
+	{
+		s->index = outSlots.size();
+		outSlots.add(s);
+	}
 	return s;
 }
 
 
-void Node::receivePointCloud(NodeConnectionSlot* slot, CloudPtr cloud)
+void Node::receivePointCloud(NodeConnectionSlot* slot, CloudPtr cloud, int64 frameID)
 {
+	if (FrameSlotBuffers* b = getFrameBuffersForReceive(slot, frameID))
+	{
+		b->slotCloudMap.set(slot, cloud);
+		return;
+	}
+
 	slotCloudMap.set(slot, cloud);
 	checkAddNextToProcessForSlot(slot);
 }
 
-void Node::receiveClusters(NodeConnectionSlot* slot, Array<ClusterPtr> clusters)
+void Node::receiveClusters(NodeConnectionSlot* slot, Array<ClusterPtr> clusters, int64 frameID)
 {
+	if (FrameSlotBuffers* b = getFrameBuffersForReceive(slot, frameID))
+	{
+		b->slotClustersMap.set(slot, clusters);
+		return;
+	}
+
 	slotClustersMap.set(slot, clusters);
 	checkAddNextToProcessForSlot(slot);
 }
 
-void Node::receiveMatrix(NodeConnectionSlot* slot, cv::Mat matrix)
+void Node::receiveMatrix(NodeConnectionSlot* slot, cv::Mat matrix, int64 frameID)
 {
+	if (FrameSlotBuffers* b = getFrameBuffersForReceive(slot, frameID))
+	{
+		b->slotMatrixMap.set(slot, matrix);
+		return;
+	}
+
 	slotMatrixMap.set(slot, matrix);
 	checkAddNextToProcessForSlot(slot);
 }
 
-void Node::receiveTransform(NodeConnectionSlot* slot, cv::Affine3f transform)
+void Node::receiveTransform(NodeConnectionSlot* slot, cv::Affine3f transform, int64 frameID)
 {
+	if (FrameSlotBuffers* b = getFrameBuffersForReceive(slot, frameID))
+	{
+		b->slotTransformMap.set(slot, transform);
+		return;
+	}
+
 	slotTransformMap.set(slot, transform);
 	checkAddNextToProcessForSlot(slot);
 }
 
-void Node::receiveVector(NodeConnectionSlot* slot, Eigen::Vector3f vector)
+void Node::receiveVector(NodeConnectionSlot* slot, Eigen::Vector3f vector, int64 frameID)
 {
+	if (FrameSlotBuffers* b = getFrameBuffersForReceive(slot, frameID))
+	{
+		b->slotVectorMap.set(slot, vector);
+		return;
+	}
+
 	slotVectorMap.set(slot, vector);
 	checkAddNextToProcessForSlot(slot);
 }
 
-void Node::receiveIndices(NodeConnectionSlot* slot, PIndices indices)
+void Node::receiveIndices(NodeConnectionSlot* slot, PIndices indices, int64 frameID)
 {
+	if (FrameSlotBuffers* b = getFrameBuffersForReceive(slot, frameID))
+	{
+		b->slotIndicesMap.set(slot, indices);
+		return;
+	}
+
 	slotIndicesMap.set(slot, indices);
 	checkAddNextToProcessForSlot(slot);
 }
 
-void Node::receiveImage(NodeConnectionSlot* slot, Image image)
+void Node::receiveImage(NodeConnectionSlot* slot, Image image, int64 frameID)
 {
+	if (FrameSlotBuffers* b = getFrameBuffersForReceive(slot, frameID))
+	{
+		b->slotImageMap.set(slot, image);
+		return;
+	}
+
 	slotImageMap.set(slot, image);
 	checkAddNextToProcessForSlot(slot);
 }
@@ -199,6 +328,49 @@ void Node::clearSlotMaps()
 	slotIndicesMap.clear();
 }
 
+Node::FrameSlotBuffers* Node::getFrameBuffersForReceive(NodeConnectionSlot* slot, int64 frameID)
+{
+	if (frameID < 0) return nullptr;
+
+	FrameSlotBuffers* b = frameSlotBuffers[frameID % maxPipelineDepth];
+	GenericScopedLock lock(b->lock);
+
+	//a frame only reuses a buffer once the frame that used it before has been fully processed
+	jassert(b->frameID <= frameID);
+	if (b->frameID != frameID)
+	{
+		b->clear();
+		b->frameID = frameID;
+	}
+
+	if (slot->processOnReceive) b->shouldProcess = true;
+	return b;
+}
+
+void Node::FrameSlotBuffers::setNumSlots(int numSlots)
+{
+	slotCloudMap.setNumSlots(numSlots);
+	slotClustersMap.setNumSlots(numSlots);
+	slotMatrixMap.setNumSlots(numSlots);
+	slotTransformMap.setNumSlots(numSlots);
+	slotVectorMap.setNumSlots(numSlots);
+	slotIndicesMap.setNumSlots(numSlots);
+	slotImageMap.setNumSlots(numSlots);
+}
+
+void Node::FrameSlotBuffers::clear()
+{
+	frameID = -1;
+	shouldProcess = false;
+	slotCloudMap.clear();
+	slotClustersMap.clear();
+	slotMatrixMap.clear();
+	slotTransformMap.clear();
+	slotVectorMap.clear();
+	slotIndicesMap.clear();
+	slotImageMap.clear();
+}
+
 void Node::sendPointCloud(NodeConnectionSlot* slot, CloudPtr cloud)
 {
 	if (slot == nullptr) return;
@@ -208,7 +380,7 @@ void Node::sendPointCloud(NodeConnectionSlot* slot, CloudPtr cloud)
 	{
 		if(!checkConnectionCanSend(c)) continue;
 		//if (!c->dest->node->enabled->boolValue()) continue;
-		c->dest->node->receivePointCloud(c->dest, cloud);
+		c->dest->node->receivePointCloud(c->dest, cloud, processingFrameID);
 	}
 }
 
@@ -219,7 +391,7 @@ void Node::sendClusters(NodeConnectionSlot* slot, Array<ClusterPtr> clusters)
 	{
 		if(!checkConnectionCanSend(c)) continue;
 		//if (!c->dest->node->enabled->boolValue()) continue;
-		c->dest->node->receiveClusters(c->dest, clusters);
+		c->dest->node->receiveClusters(c->dest, clusters, processingFrameID);
 	}
 }
 
@@ -230,7 +402,7 @@ void Node::sendMatrix(NodeConnectionSlot* slot, cv::Mat matrix)
 	{
 		if(!checkConnectionCanSend(c)) continue;
 		//if (!c->dest->node->enabled->boolValue()) continue;
-		c->dest->node->receiveMatrix(c->dest, matrix);
+		c->dest->node->receiveMatrix(c->dest, matrix, processingFrameID);
 	}
 }
 
@@ -242,7 +414,7 @@ void Node::sendTransform(NodeConnectionSlot* slot, cv::Affine3f transform)
 	{
 		if(!checkConnectionCanSend(c)) continue;
 		//if (!c->dest->node->enabled->boolValue()) continue;
-		c->dest->node->receiveTransform(c->dest, transform);
+		c->dest->node->receiveTransform(c->dest, transform, processingFrameID);
 	}
 }
 
@@ -253,7 +425,7 @@ void Node::sendVector(NodeConnectionSlot* slot, Eigen::Vector3f vector)
 	{
 		if(!checkConnectionCanSend(c)) continue;
 		//if (!c->dest->node->enabled->boolValue()) continue;
-		c->dest->node->receiveVector(c->dest, vector);
+		c->dest->node->receiveVector(c->dest, vector, processingFrameID);
 	}
 }
 
@@ -264,7 +436,7 @@ void Node::sendIndices(NodeConnectionSlot* slot, PIndices indices)
 	{
 		if(!checkConnectionCanSend(c)) continue;
 		//if (!c->dest->node->enabled->boolValue()) continue;
-		c->dest->node->receiveIndices(c->dest, indices);
+		c->dest->node->receiveIndices(c->dest, indices, processingFrameID);
 	}
 }
 
@@ -276,7 +448,7 @@ void Node::sendImage(NodeConnectionSlot* slot, Image image)
 	{
 		if (!checkConnectionCanSend(c)) continue;
 		//if (!c->dest->node->enabled->boolValue()) continue;
-		c->dest->node->receiveImage(c->dest, image);
+		c->dest->node->receiveImage(c->dest, image, processingFrameID);
 	}
 }
 
@@ -41,17 +41,50 @@ public:
 	OwnedArray<NodeConnectionSlot, CriticalSection> inSlots;
 	OwnedArray<NodeConnectionSlot, CriticalSection> outSlots;
 
-	//Buffer data
-	HashMap<NodeConnectionSlot*, CloudPtr> slotCloudMap;
-	HashMap<NodeConnectionSlot*, Array<ClusterPtr>> slotClustersMap;
-	HashMap<NodeConnectionSlot*, cv::Mat> slotMatrixMap;
-	HashMap<NodeConnectionSlot*, cv::Affine3f> slotTransformMap;
-	HashMap<NodeConnectionSlot*, Eigen::Vector3f> slotVectorMap;
-	HashMap<NodeConnectionSlot*, PIndices> slotIndicesMap;
-	HashMap<NodeConnectionSlot*, Image> slotImageMap;
+	//Buffer data, one entry per input slot allocated in addSlot
+	SlotData<CloudPtr> slotCloudMap;
+	SlotData<Array<ClusterPtr>> slotClustersMap;
+	SlotData<cv::Mat> slotMatrixMap;
+	SlotData<cv::Affine3f> slotTransformMap;
+	SlotData<Eigen::Vector3f> slotVectorMap;
+	SlotData<PIndices> slotIndicesMap;
+	SlotData<Image> slotImageMap;
+
+	//Pipelining, data received for a frame that this node has not started yet is kept here until beginFrame
+	static const int maxPipelineDepth = 4;
+	struct FrameSlotBuffers
+	{
+		int64 frameID = -1;
+		bool shouldProcess = false;
+		SpinLock lock;
+
+		SlotData<CloudPtr> slotCloudMap;
+		SlotData<Array<ClusterPtr>> slotClustersMap;
+		SlotData<cv::Mat> slotMatrixMap;
+		SlotData<cv::Affine3f> slotTransformMap;
+		SlotData<Eigen::Vector3f> slotVectorMap;
+		SlotData<PIndices> slotIndicesMap;
+		SlotData<Image> slotImageMap;
+
+		void setNumSlots(int numSlots);
+		void clear();
+	};
+
+	OwnedArray<FrameSlotBuffers> frameSlotBuffers;
+	int64 processingFrameID; //-1 when not pipelined
+	int64 processedFrameIDs[maxPipelineDepth];
 
 	HashMap<NodeConnectionSlot*, NodeConnectionSlot*> passthroughMap;
 
+	//Point fusion, set by the root node manager before processing. The last node of a chain of point-wise nodes
+	//runs the stages of the whole chain in a single pass, the nodes before it only forward their input
+	Array<Node*> fusedNodes; //nodes before this one whose stages are run here, in order
+	Node* fusedInto; //the node running this one's stages
+	Node* fusedConsumer; //the node after this one whose input stages are run here
+	Node* inputStagesRunBy; //the node running this one's input stages
+	std::unique_ptr<PointKernel> pointKernel;
+	Array<NodeConnectionSlot*> exclusiveInputs; //inputs fed by an output that is connected to nothing else
+
 	//process
 	SpinLock processLock;
 	bool processOnlyOnce;
@@ -83,25 +116,46 @@ public:
 
 	virtual void resetForNextLoop();
 	virtual bool isStartingNode();
+
+	bool beginFrame(int64 frameID);
+	bool hasProcessedFrame(int64 frameID);
 	
 	virtual bool haveAllConnectedInputsProcessed();
 
 	virtual void onContainerParameterChangedInternal(Parameter* p) override;
 
+	//Point fusion
+	virtual bool canFusePoints() { return false; } //the node only works point by point, from getFusionInput to getFusionOutput
+	virtual NodeConnectionSlot* getFusionInput() { return nullptr; }
+	virtual NodeConnectionSlot* getFusionOutput() { return nullptr; }
+	virtual void addPointStages(PointKernel& kernel) {}
+	virtual bool canRunInputStagesUpstream(NodeConnectionSlot* slot) { return false; } //point-wise stages done first on this input
+	virtual void addInputPointStages(PointKernel& kernel) {}
+
+	bool isFusedIntoNext() const { return fusedInto != nullptr && fusedInto->enabled->boolValue(); }
+	bool areInputStagesRunUpstream() const { return inputStagesRunBy != nullptr && inputStagesRunBy->enabled->boolValue(); }
+	bool isPointChainTail() const { return !fusedNodes.isEmpty() || fusedConsumer != nullptr; }
+	CloudPtr runPointChain(const CloudPtr& source);
+
+	//True when the points of a cloud received on slot can be modified. localRefs is the number of references the caller holds,
+	//usually its slot map entry and its local pointer. Every other holder of the points must own a CloudPtr to be counted.
+	bool canWriteInputInPlace(NodeConnectionSlot* slot, const CloudPtr& cloud, int localRefs = 2);
+
 	//Slots
 	NodeConnectionSlot* addSlot(StringRef name, bool isInput, NodeConnectionType t);
 
 	//IO
-	virtual void receivePointCloud(NodeConnectionSlot* slot, CloudPtr cloud);
-	virtual void receiveClusters(NodeConnectionSlot* slot, Array<ClusterPtr> clusters);
-	virtual void receiveMatrix(NodeConnectionSlot* slot, cv::Mat matrix);
-	virtual void receiveTransform(NodeConnectionSlot* slot, cv::Affine3f transform);
-	virtual void receiveVector(NodeConnectionSlot* slot, Eigen::Vector3f vector);
-	virtual void receiveIndices(NodeConnectionSlot* slot, PIndices indices);
-	virtual void receiveImage(NodeConnectionSlot* slot, Image indices);
+	virtual void receivePointCloud(NodeConnectionSlot* slot, CloudPtr cloud, int64 frameID = -1);
+	virtual void receiveClusters(NodeConnectionSlot* slot, Array<ClusterPtr> clusters, int64 frameID = -1);
+	virtual void receiveMatrix(NodeConnectionSlot* slot, cv::Mat matrix, int64 frameID = -1);
+	virtual void receiveTransform(NodeConnectionSlot* slot, cv::Affine3f transform, int64 frameID = -1);
+	virtual void receiveVector(NodeConnectionSlot* slot, Eigen::Vector3f vector, int64 frameID = -1);
+	virtual void receiveIndices(NodeConnectionSlot* slot, PIndices indices, int64 frameID = -1);
+	virtual void receiveImage(NodeConnectionSlot* slot, Image indices, int64 frameID = -1);
 
 
 	void clearSlotMaps();
+	FrameSlotBuffers* getFrameBuffersForReceive(NodeConnectionSlot* slot, int64 frameID);
 
 	void sendPointCloud(NodeConnectionSlot* slot, CloudPtr cloud);
 	void sendClusters(NodeConnectionSlot* slot, Array<ClusterPtr> clusters);
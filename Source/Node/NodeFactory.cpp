@@ -37,5 +37,6 @@ NodeFactory::NodeFactory()
 
 
     defs.add(Definition::createDef<WebsocketOutputNode>("Output", WebsocketOutputNode::getTypeStringStatic()));
+    defs.add(Definition::createDef<AugmentaOutputNode>("Output", AugmentaOutputNode::getTypeStringStatic()));
 
 }
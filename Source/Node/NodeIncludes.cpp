@@ -11,6 +11,8 @@
 
 #include "NodeIncludes.h"
 
+#include "Common/PointKernel.cpp"
+
 
 #include "Connection/NodeConnection.cpp"
 #include "Connection/NodeConnectionSlot.cpp"
@@ -18,6 +20,7 @@
 
 #include "Connection/NodeConnectionManager.cpp"
 #include "NodeFactory.cpp"
+#include "NodeScheduler.cpp"
 #include "NodeManager.cpp"
 
 
@@ -16,6 +16,10 @@
 // 
 //pcl
 #include "Common/PCLHelpers.h"
+#include "Common/TripleBuffer.h"
+#include "Common/ParallelHelpers.h"
+#include "Common/StreamProtocol.h"
+#include "Common/PointKernel.h"
 
 //orbbec
 #pragma warning(push)
@@ -37,6 +41,7 @@
 
 #include "Connection/NodeConnectionManager.h"
 #include "NodeFactory.h"
+#include "NodeScheduler.h"
 #include "NodeManager.h"
 
 #include "nodes/Filter/cropbox/CropboxNode.h"
@@ -48,6 +53,7 @@
 #include "nodes/Output/websocket/WebsocketOutputNode.h"
 
 #include "nodes/Filter/tracking/Hungarian.h"
+#include "nodes/Filter/tracking/TrackAssignment.h"
 #include "nodes/Filter/tracking/TrackingNode.h"
 
 #include "nodes/Filter/oneeuro/OneEuroFilter.h"
@@ -55,6 +61,7 @@
 
 #include "nodes/Filter/qrcode/QRCodeNode.h"
 
+#include "nodes/Filter/recorder/CloudRecordFile.h"
 #include "nodes/Filter/recorder/RecorderNode.h"
 
 #include "nodes/Filter/transform/TransformNode.h"
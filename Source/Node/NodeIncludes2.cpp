@@ -18,6 +18,7 @@
 #include "nodes/Filter/prediction/PredictionNode.cpp"
 
 #include "nodes/Filter/tracking/Hungarian.cpp"
+#include "nodes/Filter/tracking/TrackAssignment.cpp"
 #include "nodes/Filter/tracking/TrackingNode.cpp"
 
 #include "nodes/Filter/oneeuro/OneEuroFilter.cpp"
@@ -25,6 +26,7 @@
 
 #include "nodes/Filter/qrcode/QRCodeNode.cpp"
 
+#include "nodes/Filter/recorder/CloudRecordFile.cpp"
 #include "nodes/Filter/recorder/RecorderNode.cpp"
 
 #include "nodes/Filter/transform/TransformNode.cpp"
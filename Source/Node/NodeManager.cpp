@@ -106,16 +106,24 @@ RootNodeManager::RootNodeManager() :
 	NodeManager(),
 	Thread("Nodes"),
 	processTimeMS(1),
-	averageFPS(0)
+	averageFPS(0),
+	cycleWarningShown(false)
 {
 	Engine::mainEngine->addEngineListener(this);
 	fps = addIntParameter("FPS", "Target process rate", 30, 1, 500);
+	parallelProcessing = addBoolParameter("Parallel Processing", "If checked, independent branches of the graph will be processed at the same time on multiple threads", true);
+	numThreads = addIntParameter("Process Threads", "Number of threads to use when parallel processing is enabled", jlimit(1, 16, SystemStats::getNumCpus()), 1, 64);
+	pipelineDepth = addIntParameter("Pipeline Depth", "Number of frames that can be processed at the same time when parallel processing is enabled. More than 1 raises the throughput at the cost of some latency", 1, 1, Node::maxPipelineDepth);
+	fusePointNodes = addBoolParameter("Fuse Point Nodes", "If checked, chains of point by point nodes like Transform and Crop Box are processed in a single pass over the cloud when their intermediate results are not used anywhere else", true);
+
+	scheduler.reset(new NodeScheduler(this));
 }
 
 RootNodeManager::~RootNodeManager()
 {
 	if (Engine::mainEngine != nullptr) Engine::mainEngine->removeEngineListener(this);
 	stopThread(1000);
+	scheduler.reset();
 }
 
 
@@ -128,6 +136,8 @@ void RootNodeManager::addItemInternal(Node* item, var data)
 void RootNodeManager::removeItemInternal(Node* item)
 {
 	GenericScopedLock lock(itemLoopLock);
+	scheduler->waitForAllFrames(false); //pipelined frames may still be using this node
+	clearPointFusion(); //planned again on the next loop
 	NodeManager::removeItemInternal(item);
 }
 
@@ -135,6 +145,7 @@ void RootNodeManager::removeItemInternal(Node* item)
 void RootNodeManager::clear()
 {
 	stopThread(1000);
+	scheduler->waitForAllFrames(false);
 	NodeManager::clear();
 }
 
@@ -152,12 +163,40 @@ void RootNodeManager::run()
 		{
 			{
 				GenericScopedLock lock(itemLoopLock);
-				for (auto& i : items) i->resetForNextLoop();
 
-				for (auto& i : items)
+				updatePointFusion();
+
+				bool processedInParallel = false;
+				if (parallelProcessing->boolValue())
 				{
-					if (i->isStartingNode()) i->process();
+					scheduler->setNumThreads(numThreads->intValue());
+					scheduler->setPipelineDepth(numThreads->intValue() > 1 ? pipelineDepth->intValue() : 1);
+					if (!scheduler->isPipelined()) for (auto& i : items) i->resetForNextLoop();
+
+					if (scheduler->buildGraph(Array<Node*>(items.getRawDataPointer(), items.size())))
+					{
+						scheduler->processFrame();
+						processedInParallel = true;
+						cycleWarningShown = false;
+					}
+					else if (!cycleWarningShown)
+					{
+						LOGWARNING("Node graph has a cycle, falling back to serial processing");
+						cycleWarningShown = true;
+					}
 				}
+
+				if (!processedInParallel)
+				{
+					scheduler->waitForAllFrames(true);
+					for (auto& i : items) i->resetForNextLoop();
+					for (auto& i : items)
+					{
+						if (i->isStartingNode()) i->process();
+					}
+				}
+
+				//serial pass for anything still waiting, should only happen in serial mode
 				while (!threadShouldExit() && !nextToProcess.isEmpty())
 				{
 					Array<Node*> processList;
@@ -185,10 +224,141 @@ void RootNodeManager::run()
 		if (timeToWait > 0) wait(timeToWait); //to make dynamically changing with process time
 	}
 
+	scheduler->waitForAllFrames(true);
 	nextToProcess.clear();
 
 }
 
+void RootNodeManager::updatePointFusion()
+{
+	struct FusionPlan
+	{
+		Array<Node*> fusedNodes;
+		Node* fusedInto = nullptr;
+		Node* fusedConsumer = nullptr;
+		Node* inputStagesRunBy = nullptr;
+		Array<NodeConnectionSlot*> exclusiveInputs;
+	};
+
+	const int numItems = items.size();
+	std::vector<FusionPlan> plans(numItems);
+
+	//clouds received there are not shared with any other node, they can be written in place
+	for (int i = 0; i < numItems; i++)
+	{
+		for (auto& s : items[i]->inSlots)
+		{
+			if (s->type != POINTCLOUD || s->connections.size() != 1) continue;
+			NodeConnection* c = s->connections[0];
+			if (c->enabled->boolValue() && c->source != nullptr && c->source->connections.size() == 1) plans[i].exclusiveInputs.add(s);
+		}
+	}
+
+	if (fusePointNodes->boolValue())
+	{
+		Array<Node*> nextNodes;
+		Array<Node*> hasPrevious;
+		for (auto& n : items)
+		{
+			Node* next = getNextPointNode(n);
+			nextNodes.add(next);
+			if (next != nullptr) hasPrevious.add(next);
+		}
+
+		for (int i = 0; i < numItems; i++)
+		{
+			Node* n = items[i];
+			if (!n->enabled->boolValue() || !n->canFusePoints() || hasPrevious.contains(n)) continue;
+
+			Array<Node*> chain;
+			chain.add(n);
+			for (Node* next = nextNodes[i]; next != nullptr && !chain.contains(next); next = nextNodes[items.indexOf(next)]) chain.add(next);
+
+			Node* tail = chain.getLast();
+			Node* consumer = nullptr;
+			if (NodeConnectionSlot* dest = getSinglePointDestination(tail))
+			{
+				if (dest->node->enabled->boolValue() && dest->node->canRunInputStagesUpstream(dest)) consumer = dest->node;
+			}
+
+			if (chain.size() < 2 && consumer == nullptr) continue;
+
+			FusionPlan& tailPlan = plans[items.indexOf(tail)];
+			for (int c = 0; c < chain.size() - 1; c++)
+			{
+				plans[items.indexOf(chain[c])].fusedInto = tail;
+				tailPlan.fusedNodes.add(chain[c]);
+			}
+
+			tailPlan.fusedConsumer = consumer;
+			if (consumer != nullptr) plans[items.indexOf(consumer)].inputStagesRunBy = tail;
+		}
+	}
+
+	bool changed = false;
+	for (int i = 0; i < numItems && !changed; i++)
+	{
+		Node* n = items[i];
+		const FusionPlan& p = plans[i];
+		changed = n->fusedNodes != p.fusedNodes || n->fusedInto != p.fusedInto || n->fusedConsumer != p.fusedConsumer || n->inputStagesRunBy != p.inputStagesRunBy
+			|| n->exclusiveInputs != p.exclusiveInputs;
+	}
+
+	if (!changed) return;
+
+	//frames in flight were started with the previous plan
+	scheduler->waitForAllFrames(true);
+
+	for (int i = 0; i < numItems; i++)
+	{
+		Node* n = items[i];
+		n->fusedNodes = plans[i].fusedNodes;
+		n->fusedInto = plans[i].fusedInto;
+		n->fusedConsumer = plans[i].fusedConsumer;
+		n->inputStagesRunBy = plans[i].inputStagesRunBy;
+		n->exclusiveInputs = plans[i].exclusiveInputs;
+	}
+}
+
+void RootNodeManager::clearPointFusion()
+{
+	for (auto& n : items)
+	{
+		n->fusedNodes.clear();
+		n->fusedInto = nullptr;
+		n->fusedConsumer = nullptr;
+		n->inputStagesRunBy = nullptr;
+		n->exclusiveInputs.clear();
+	}
+}
+
+NodeConnectionSlot* RootNodeManager::getSinglePointDestination(Node* n)
+{
+	//the fusion output must only feed one input, and that input must not receive anything else
+	NodeConnectionSlot* out = n->getFusionOutput();
+	if (out == nullptr || out->connections.size() != 1) return nullptr;
+	for (auto& s : n->outSlots) if (s != out && !s->isEmpty()) return nullptr;
+
+	NodeConnection* c = out->connections[0];
+	if (!c->enabled->boolValue() || c->dest == nullptr || c->dest->node == nullptr) return nullptr;
+	if (c->dest->connections.size() != 1) return nullptr;
+
+	return c->dest;
+}
+
+Node* RootNodeManager::getNextPointNode(Node* n)
+{
+	if (!n->enabled->boolValue() || !n->canFusePoints()) return nullptr;
+
+	NodeConnectionSlot* dest = getSinglePointDestination(n);
+	if (dest == nullptr) return nullptr;
+
+	Node* next = dest->node;
+	if (!next->enabled->boolValue() || !next->canFusePoints() || dest != next->getFusionInput()) return nullptr;
+
+	return next;
+}
+
 void RootNodeManager::startLoadFile()
 {
 	startThread();
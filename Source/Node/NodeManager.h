@@ -52,16 +52,30 @@ public:
     Array<Node*, CriticalSection> nextToProcess;
 
     IntParameter* fps;
+    BoolParameter* parallelProcessing;
+    IntParameter* numThreads;
+    IntParameter* pipelineDepth;
+    BoolParameter* fusePointNodes;
     int processTimeMS;
     int averageFPS;
     int maxFPS;
 
     SpinLock itemLoopLock;
 
+    std::unique_ptr<NodeScheduler> scheduler;
+    bool cycleWarningShown;
+
     void clear() override;
 
     void run() override;
 
+    //Point fusion, chains of point-wise nodes whose intermediate outputs only feed the next node are run in a single pass.
+    //Also finds the inputs that are the only receiver of their sender, where clouds can be written in place
+    void updatePointFusion();
+    void clearPointFusion();
+    NodeConnectionSlot* getSinglePointDestination(Node* n);
+    Node* getNextPointNode(Node* n);
+
     void addItemInternal(Node* item, var data) override;
     void removeItemInternal(Node* item) override;
 
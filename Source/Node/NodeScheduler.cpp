@@ -0,0 +1,326 @@
+/*
+  ==============================================================================
+
+	NodeScheduler.cpp
+	Created: 18 Oct 2026 6:29:36am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+NodeScheduler::NodeScheduler(RootNodeManager* manager) :
+	manager(manager),
+	graphIsValid(false),
+	pipelineDepth(1),
+	nextFrameID(0),
+	oldestFrameID(0)
+{
+	queues.add(new TaskQueue());
+}
+
+NodeScheduler::~NodeScheduler()
+{
+	waitForAllFrames(false);
+	stopWorkers();
+}
+
+void NodeScheduler::setNumThreads(int numThreads)
+{
+	numThreads = jmax(numThreads, 1);
+	if (queues.size() == numThreads) return;
+
+	waitForAllFrames(true);
+	stopWorkers();
+
+	queues.clear();
+	for (int i = 0; i < numThreads; i++) queues.add(new TaskQueue());
+	for (int i = 1; i < numThreads; i++)
+	{
+		Worker* w = new Worker(this, i);
+		workers.add(w);
+		w->startThread();
+	}
+}
+
+void NodeScheduler::setPipelineDepth(int depth)
+{
+	depth = jlimit(1, (int)Node::maxPipelineDepth, depth);
+	if (depth == pipelineDepth) return;
+
+	waitForAllFrames(true);
+	pipelineDepth = depth;
+}
+
+int NodeScheduler::getNumFramesInFlight()
+{
+	GenericScopedLock lock(frameLock);
+	return (int)(nextFrameID - oldestFrameID);
+}
+
+void NodeScheduler::stopWorkers()
+{
+	for (auto& w : workers)
+	{
+		w->signalThreadShouldExit();
+		w->workAvailable.signal();
+	}
+	workers.clear(); //each worker waits for its thread to stop
+}
+
+bool NodeScheduler::buildGraph(Array<Node*> nodes)
+{
+	OwnedArray<NodeTask> newTasks;
+	bool isValid = createTasks(nodes, newTasks);
+	if (isSameGraph(newTasks)) return graphIsValid;
+
+	//frames in flight were scheduled with the old graph, let them finish before switching
+	waitForAllFrames(true);
+
+	GenericScopedLock lock(frameLock);
+	for (auto& t : newTasks) t->lastFinishedFrameID = nextFrameID - 1;
+	tasks.swapWith(newTasks);
+	graphIsValid = isValid;
+
+	return graphIsValid;
+}
+
+bool NodeScheduler::createTasks(Array<Node*> nodes, OwnedArray<NodeTask>& result)
+{
+	HashMap<Node*, int> nodeIndexMap;
+	for (int i = 0; i < nodes.size(); i++)
+	{
+		NodeTask* t = new NodeTask();
+		t->node = nodes[i];
+		result.add(t);
+		nodeIndexMap.set(nodes[i], i);
+	}
+
+	bool hasSelfConnection = false;
+	for (int i = 0; i < result.size(); i++)
+	{
+		for (auto& s : result[i]->node->inSlots)
+		{
+			for (auto& c : s->connections)
+			{
+				if (!c->enabled->boolValue() || c->source == nullptr) continue;
+				Node* sourceNode = c->source->node.get();
+				if (sourceNode == nullptr || !nodeIndexMap.contains(sourceNode)) continue;
+
+				int p = nodeIndexMap[sourceNode];
+				if (p == i)
+				{
+					hasSelfConnection = true; //can't be scheduled as a graph
+					continue;
+				}
+
+				if (result[p]->successors.contains(i)) continue;
+
+				result[p]->successors.add(i);
+				result[i]->numPredecessors++;
+			}
+		}
+	}
+
+	if (hasSelfConnection) return false;
+
+	//Kahn's algorithm, only to check that there is no cycle in the graph
+	Array<int> remaining;
+	Array<int> ready;
+	for (int i = 0; i < result.size(); i++)
+	{
+		remaining.add(result[i]->numPredecessors);
+		if (remaining[i] == 0) ready.add(i);
+	}
+
+	int numVisited = 0;
+	while (!ready.isEmpty())
+	{
+		int i = ready.removeAndReturn(ready.size() - 1);
+		numVisited++;
+		for (auto& s : result[i]->successors)
+		{
+			remaining.set(s, remaining[s] - 1);
+			if (remaining[s] == 0) ready.add(s);
+		}
+	}
+
+	return numVisited == result.size();
+}
+
+bool NodeScheduler::isSameGraph(OwnedArray<NodeTask>& other)
+{
+	if (other.size() != tasks.size()) return false;
+	for (int i = 0; i < tasks.size(); i++)
+	{
+		if (other[i]->node != tasks[i]->node) return false;
+		if (other[i]->successors != tasks[i]->successors) return false;
+	}
+	return true;
+}
+
+void NodeScheduler::processFrame()
+{
+	if (tasks.isEmpty() || !graphIsValid) return;
+
+	//wait for the oldest frame to free its slot, helping with the work in the meantime
+	while (getNumFramesInFlight() >= pipelineDepth)
+	{
+		TaskRef task;
+		if (popTask(0, task)) runTask(0, task);
+		else workAvailable.wait(-1);
+	}
+
+	startFrame();
+
+	if (!isPipelined()) waitForAllFrames(true);
+}
+
+void NodeScheduler::startFrame()
+{
+	GenericScopedLock lock(frameLock);
+
+	int64 frameID = nextFrameID++;
+	int slot = (int)(frameID % Node::maxPipelineDepth);
+	remainingTasks[slot] = tasks.size();
+
+	//spread the starting tasks across all queues so independent branches start on different threads
+	int queueIndex = 0;
+	for (int i = 0; i < tasks.size(); i++)
+	{
+		NodeTask* t = tasks[i];
+		t->pendingPredecessors[slot] = t->numPredecessors + (t->lastFinishedFrameID < frameID - 1 ? 1 : 0);
+		if (t->pendingPredecessors[slot] > 0) continue;
+
+		pushTask(queueIndex, { i, frameID });
+		queueIndex = (queueIndex + 1) % queues.size();
+	}
+}
+
+void NodeScheduler::waitForAllFrames(bool participate)
+{
+	while (getNumFramesInFlight() > 0)
+	{
+		TaskRef task;
+		if (participate && popTask(0, task)) runTask(0, task);
+		else if (participate) workAvailable.wait(-1);
+		else frameFinished.wait(-1);
+	}
+}
+
+void NodeScheduler::pushTask(int queueIndex, TaskRef task)
+{
+	{
+		TaskQueue* q = queues[queueIndex];
+		GenericScopedLock lock(q->lock);
+		q->tasks.add(task);
+	}
+
+	++queuedTasks;
+	signalWorkAvailable();
+}
+
+void NodeScheduler::signalWorkAvailable()
+{
+	//one event per thread so no wake up is lost or taken by the wrong thread, idle threads only wake up for a new task or a finished frame
+	workAvailable.signal();
+	for (auto& w : workers) w->workAvailable.signal();
+}
+
+bool NodeScheduler::popTask(int queueIndex, TaskRef& task)
+{
+	if (queuedTasks.get() == 0) return false;
+
+	//own queue first, last in first out to keep a branch on the same thread
+	{
+		TaskQueue* q = queues[queueIndex];
+		GenericScopedLock lock(q->lock);
+		if (!q->tasks.isEmpty())
+		{
+			task = q->tasks.removeAndReturn(q->tasks.size() - 1);
+			--queuedTasks;
+			return true;
+		}
+	}
+
+	//steal the oldest task of another queue
+	for (int i = 1; i < queues.size(); i++)
+	{
+		TaskQueue* q = queues[(queueIndex + i) % queues.size()];
+		GenericScopedLock lock(q->lock);
+		if (!q->tasks.isEmpty())
+		{
+			task = q->tasks.removeAndReturn(0);
+			--queuedTasks;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void NodeScheduler::runTask(int queueIndex, TaskRef task)
+{
+	Node* n = tasks[task.taskIndex]->node;
+
+	bool shouldProcess = false;
+	if (isPipelined()) shouldProcess = n->beginFrame(task.frameID) || n->isStartingNode();
+	else shouldProcess = n->isStartingNode() || manager->nextToProcess.contains(n);
+
+	if (shouldProcess) n->process();
+
+	finishTask(queueIndex, task);
+}
+
+void NodeScheduler::finishTask(int queueIndex, TaskRef task)
+{
+	GenericScopedLock lock(frameLock);
+
+	NodeTask* t = tasks[task.taskIndex];
+	int slot = (int)(task.frameID % Node::maxPipelineDepth);
+	t->lastFinishedFrameID = task.frameID;
+
+	for (auto& s : t->successors)
+	{
+		if (--tasks[s]->pendingPredecessors[slot] == 0) pushTask(queueIndex, { s, task.frameID });
+	}
+
+	//the same node can now process the next frame if it has already started
+	int64 nextID = task.frameID + 1;
+	if (nextID < nextFrameID)
+	{
+		int nextSlot = (int)(nextID % Node::maxPipelineDepth);
+		if (--t->pendingPredecessors[nextSlot] == 0) pushTask(queueIndex, { task.taskIndex, nextID });
+	}
+
+	if (--remainingTasks[slot] == 0)
+	{
+		//a node always finishes a frame before the next one, so frames finish in order
+		jassert(task.frameID == oldestFrameID);
+		oldestFrameID++;
+		frameFinished.signal();
+		signalWorkAvailable();
+	}
+}
+
+
+NodeScheduler::Worker::Worker(NodeScheduler* scheduler, int queueIndex) :
+	Thread("Nodes Worker " + String(queueIndex)),
+	scheduler(scheduler),
+	queueIndex(queueIndex)
+{
+}
+
+NodeScheduler::Worker::~Worker()
+{
+	stopThread(1000);
+}
+
+void NodeScheduler::Worker::run()
+{
+	while (!threadShouldExit())
+	{
+		TaskRef task;
+		if (scheduler->popTask(queueIndex, task)) scheduler->runTask(queueIndex, task);
+		else workAvailable.wait(-1);
+	}
+}
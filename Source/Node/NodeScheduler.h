@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+	NodeScheduler.h
+	Created: 18 Oct 2026 6:29:36am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+#pragma once
+
+class RootNodeManager;
+
+class NodeScheduler
+{
+public:
+	NodeScheduler(RootNodeManager* manager);
+	~NodeScheduler();
+
+	RootNodeManager* manager;
+
+	struct NodeTask
+	{
+		Node* node = nullptr;
+		Array<int> successors;
+		int numPredecessors = 0;
+
+		//one counter per in-flight frame, the node's own previous frame counts as a predecessor when pipelined
+		int pendingPredecessors[Node::maxPipelineDepth];
+		int64 lastFinishedFrameID = -1;
+	};
+
+	struct TaskRef
+	{
+		int taskIndex = -1;
+		int64 frameID = -1;
+	};
+
+	struct TaskQueue
+	{
+		Array<TaskRef> tasks;
+		SpinLock lock;
+	};
+
+	class Worker :
+		public Thread
+	{
+	public:
+		Worker(NodeScheduler* scheduler, int queueIndex);
+		~Worker();
+
+		NodeScheduler* scheduler;
+		int queueIndex;
+		WaitableEvent workAvailable;
+
+		void run() override;
+	};
+
+	OwnedArray<NodeTask> tasks;
+	OwnedArray<TaskQueue> queues; //queue 0 is for the calling thread, others are for the workers
+	OwnedArray<Worker> workers;
+	bool graphIsValid;
+
+	WaitableEvent workAvailable; //for the calling thread, each worker has its own
+	WaitableEvent frameFinished;
+	Atomic<int> queuedTasks;
+
+	CriticalSection frameLock;
+	int pipelineDepth;
+	int64 nextFrameID;
+	int64 oldestFrameID;
+	int remainingTasks[Node::maxPipelineDepth];
+
+	void setNumThreads(int numThreads);
+	void setPipelineDepth(int depth);
+	bool isPipelined() const { return pipelineDepth > 1; }
+	int getNumFramesInFlight();
+
+	bool buildGraph(Array<Node*> nodes);
+	bool createTasks(Array<Node*> nodes, OwnedArray<NodeTask>& result);
+	bool isSameGraph(OwnedArray<NodeTask>& other);
+
+	void processFrame();
+	void startFrame();
+	void waitForAllFrames(bool participate);
+
+	void pushTask(int queueIndex, TaskRef task);
+	void signalWorkAvailable();
+	bool popTask(int queueIndex, TaskRef& task);
+	void runTask(int queueIndex, TaskRef task);
+	void finishTask(int queueIndex, TaskRef task);
+
+private:
+	void stopWorkers();
+};
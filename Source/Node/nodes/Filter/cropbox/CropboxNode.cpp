@@ -10,7 +10,8 @@
 
 CropBoxNode::CropBoxNode(var params) :
 	Node(getTypeString(), FILTER, params),
-	boxes("Boxes")
+	boxes("Boxes"),
+	lastNumEnabledBoxes(0)
 {
 	saveAndLoadRecursiveData = true;
 
@@ -34,77 +35,148 @@ void CropBoxNode::processInternal()
 {
 
 	CloudPtr source = slotCloudMap[in];
-	if (source->empty()) return;
+	if (source == nullptr || source->empty()) return;
 
-
-	pcl::IndicesPtr indices(new pcl::Indices);
-	if (cleanUp->boolValue())
+	if (isFusedIntoNext())
 	{
-		pcl::removeNaNFromPointCloud(*source, *indices);
-		//NNLOG("Clean cloud size : " << (int)sCloud->size());
+		sendPointCloud(out, source);
+		return;
 	}
 
+	if (isPointChainTail())
 	{
-		GenericScopedLock(boxes.items.getLock());
-		for (auto& b : boxes.items)
-		{
-			if (!b->enabled->boolValue()) continue;
+		sendPointCloud(out, runPointChain(source));
+		return;
+	}
 
-			Vector3D minV = b->minPoint->getVector();
-			Vector3D maxV = b->maxPoint->getVector();
-			CropMode m = b->cropMode->getValueDataAsEnum<CropMode>();
+	prepareBoxTests(boxTests);
 
-			pcl::CropBox<pcl::PointXYZ> filter;
+	const int numPoints = (int)source->size();
+	const int numBoxes = (int)boxTests.size();
+	const bool clean = cleanUp->boolValue();
 
-			filter.setInputCloud(source);
-			filter.setKeepOrganized(keepOrganized->boolValue());
-			filter.setMin(Eigen::Vector4f(minV.x, minV.y, minV.z, 1));
-			filter.setMax(Eigen::Vector4f(maxV.x, maxV.y, maxV.z, 1));
+	//without a first Add box, boxes carve into the whole cloud
+	const bool keepByDefault = numBoxes == 0 || boxTests[0].mode != ADD;
 
+	keepMask.resize(numPoints);
 
-			pcl::IndicesPtr newIndices(new pcl::Indices);
-			if (m == SUBTRACT || m == INTERSECT)
-			{
-				filter.setIndices(indices);
-				filter.setNegative(m == SUBTRACT);
+	//pass 1 : one bit per box for each point, then the box operations resolved in order on that mask
+	const int blockSize = 4096;
+	const int numBlocks = (numPoints + blockSize - 1) / blockSize;
+	Atomic<int> numKept(0);
 
-				filter.filter(*newIndices);
-				*indices = *newIndices;
-			}
-			else if (m == ADD)
+	pleiades::parallelFor(numBlocks, [&](int block)
+		{
+			int start = block * blockSize;
+			int end = jmin(start + blockSize, numPoints);
+			int blockKept = 0;
+
+			for (int i = start; i < end; i++)
 			{
-				if (indices->size() == 0)
+				const PPoint& p = source->points[i];
+				if (clean && !pcl::isFinite(p))
 				{
-					filter.filter(*indices);
+					keepMask[i] = 0;
+					continue;
 				}
-				else
+
+				Eigen::Vector4f v(p.x, p.y, p.z, 1);
+				uint64 insideBits = 0;
+				for (int b = 0; b < numBoxes; b++)
+				{
+					Eigen::Vector4f local = boxTests[b].worldToBox * v;
+					if ((local.head<3>().array().abs() <= 1.0f).all()) insideBits |= (uint64)1 << b;
+				}
+
+				bool keep = keepByDefault;
+				for (int b = 0; b < numBoxes; b++)
 				{
-					pcl::IndicesPtr removedIndices(new pcl::Indices);
-					pcl::ExtractIndices<PPoint> extract;
-					extract.setIndices(indices);
-					extract.setInputCloud(source);
-					extract.setNegative(true);
-					extract.filter(*removedIndices);
-
-					filter.setIndices(removedIndices);
-					filter.filter(*newIndices);
-					indices->insert(indices->end(), newIndices->begin(), newIndices->end());
+					bool inside = (insideBits >> b) & 1;
+					switch (boxTests[b].mode)
+					{
+					case ADD: keep |= inside; break;
+					case SUBTRACT: keep &= !inside; break;
+					case INTERSECT: keep &= inside; break;
+					}
 				}
+
+				keepMask[i] = keep ? 1 : 0;
+				if (keep) blockKept++;
 			}
 
-			NNLOG(" > " << b->cropMode->getValueKey() << " : " << indices->size());
-		}
+			numKept += blockKept;
+		}, 1);
+
+	//pass 2 : compact the survivors once
+	CloudPtr cloud;
+	if (keepOrganized->boolValue())
+	{
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		cloud.reset(new Cloud(source->width, source->height));
+		for (int i = 0; i < numPoints; i++) cloud->points[i] = keepMask[i] ? source->points[i] : PPoint(nan, nan, nan);
+		cloud->is_dense = numKept.get() == numPoints && source->is_dense;
+	}
+	else
+	{
+		cloud.reset(new Cloud(numKept.get(), 1));
+		int index = 0;
+		for (int i = 0; i < numPoints; i++) if (keepMask[i]) cloud->points[index++] = source->points[i];
+		cloud->is_dense = source->is_dense || clean;
 	}
 
+	NNLOG("After crop : " << (int)numKept.get() << " / " << numPoints);
+	sendPointCloud(out, cloud);
+}
 
-	CloudPtr cloud(new Cloud());
-	pcl::ExtractIndices<PPoint> extract;
-	extract.setInputCloud(source);
-	extract.setIndices(indices);
-	extract.filter(*cloud);
+void CropBoxNode::prepareBoxTests(BoxTestList& tests)
+{
+	tests.clear();
 
-	NNLOG("After crop : " << (int)cloud->size());
-	sendPointCloud(out, cloud);
+	GenericScopedLock lock(boxes.items.getLock());
+	for (auto& b : boxes.items)
+	{
+		if (!b->enabled->boolValue()) continue;
+		if ((int)tests.size() >= maxBoxes) break; //warned in checkNumBoxes
+
+		Vector3D<float> minV = b->minPoint->getVector();
+		Vector3D<float> maxV = b->maxPoint->getVector();
+		Vector3D<float> rot = b->rotation->getVector();
+
+		Eigen::Vector3f center((minV.x + maxV.x) / 2, (minV.y + maxV.y) / 2, (minV.z + maxV.z) / 2);
+		Eigen::Vector3f halfSize(jmax(std::abs(maxV.x - minV.x) / 2, 1e-6f), jmax(std::abs(maxV.y - minV.y) / 2, 1e-6f), jmax(std::abs(maxV.z - minV.z) / 2, 1e-6f));
+		Eigen::Quaternionf q = pleiades::euler2Quaternion(degreesToRadians(rot.z), degreesToRadians(rot.x), degreesToRadians(rot.y));
+
+		//box to world is translate(center) * rotate(q) * scale(halfSize), rotating around the box center
+		Eigen::Affine3f boxToWorld = Eigen::Affine3f::Identity();
+		boxToWorld.translate(center);
+		boxToWorld.rotate(q);
+		boxToWorld.scale(halfSize);
+
+		BoxTest t;
+		t.worldToBox = boxToWorld.inverse().matrix();
+		t.mode = b->cropMode->getValueDataAsEnum<CropMode>();
+		tests.push_back(t);
+	}
+}
+
+void CropBoxNode::addPointStages(PointKernel& kernel)
+{
+	if (!enabled->boolValue()) return;
+
+	//called from the chain tail's thread, so the tests are not shared with processInternal
+	BoxTestList tests;
+	prepareBoxTests(tests);
+
+	std::vector<PointKernel::Box> kernelBoxes;
+	for (auto& t : tests)
+	{
+		PointKernel::Box b;
+		b.worldToBox = t.worldToBox;
+		b.mode = (PointKernel::BoxMode)t.mode;
+		kernelBoxes.push_back(b);
+	}
+
+	kernel.addCrop(kernelBoxes, cleanUp->boolValue(), keepOrganized->boolValue());
 }
 
 void CropBoxNode::onContainerParameterChangedInternal(Parameter* p)
@@ -120,7 +192,30 @@ void CropBoxNode::onContainerTriggerTriggered(Trigger* t)
 void CropBoxNode::onControllableFeedbackUpdateInternal(ControllableContainer* cc, Controllable* c)
 {
 	Node::onControllableFeedbackUpdateInternal(cc, c);
-	if (cc == &boxes) notifyServerControlsUpdated();
+	if (cc == &boxes)
+	{
+		checkNumBoxes();
+		notifyServerControlsUpdated();
+	}
+}
+
+void CropBoxNode::afterLoadJSONDataInternal()
+{
+	Node::afterLoadJSONDataInternal();
+	checkNumBoxes();
+}
+
+void CropBoxNode::checkNumBoxes()
+{
+	int numEnabled = 0;
+	{
+		GenericScopedLock lock(boxes.items.getLock());
+		for (auto& b : boxes.items) if (b->enabled->boolValue()) numEnabled++;
+	}
+
+	//only when the count changes, not on every box edit
+	if (numEnabled > maxBoxes && numEnabled != lastNumEnabledBoxes) NLOGWARNING(niceName, "Only the first " << (int)maxBoxes << " boxes are used");
+	lastNumEnabledBoxes = numEnabled;
 }
 
 var CropBoxNode::getServerControls()
@@ -138,6 +233,7 @@ var CropBoxNode::getServerControls()
 			bData.getDynamicObject()->setProperty("color", b->itemColor->value);
 			bData.getDynamicObject()->setProperty("min", b->minPoint->value);
 			bData.getDynamicObject()->setProperty("max", b->maxPoint->value);
+			bData.getDynamicObject()->setProperty("rotation", b->rotation->value);
 			cData.getDynamicObject()->setProperty(b->shortName, bData);
 		}
 	}
@@ -159,6 +255,8 @@ CropBoxNode::CBox::CBox() :
 	maxPoint = addPoint3DParameter("Max", "Max Point");
 	maxPoint->setVector(1, 1, 1);
 
+	rotation = addPoint3DParameter("Rotation", "Rotation of the box around its center, in degrees. Leave to 0 for an axis-aligned box");
+
 }
 
 CropBoxNode::CBox::~CBox()
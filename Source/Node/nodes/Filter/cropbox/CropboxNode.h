@@ -34,6 +34,7 @@ public:
         EnumParameter* cropMode;
         Point3DParameter* minPoint;
         Point3DParameter* maxPoint;
+        Point3DParameter* rotation;
 
         String getTypeString() const override { return "Box"; }
     };
@@ -43,11 +44,32 @@ public:
     BoolParameter* keepOrganized;
     BoolParameter* cleanUp;
 
+    //box tests prepared once per frame, all boxes are evaluated in a single pass over the cloud
+    struct BoxTest
+    {
+        Eigen::Matrix4f worldToBox; //maps the box to [-1, 1] on each axis, handles oriented boxes at the same cost
+        CropMode mode;
+    };
+
+    static const int maxBoxes = 64;
+    typedef std::vector<BoxTest, Eigen::aligned_allocator<BoxTest>> BoxTestList;
+    BoxTestList boxTests;
+    std::vector<uint8> keepMask;
+    int lastNumEnabledBoxes;
+
     void processInternal() override;
+    void prepareBoxTests(BoxTestList& tests);
+
+    bool canFusePoints() override { return true; }
+    NodeConnectionSlot* getFusionInput() override { return in; }
+    NodeConnectionSlot* getFusionOutput() override { return out; }
+    void addPointStages(PointKernel& kernel) override;
 
     void onContainerParameterChangedInternal(Parameter* p) override;
     void onContainerTriggerTriggered(Trigger* t) override;
     void onControllableFeedbackUpdateInternal(ControllableContainer* cc, Controllable* c) override;
+    void afterLoadJSONDataInternal() override;
+    void checkNumBoxes();
 
     virtual var getServerControls() override;
     
@@ -15,6 +15,9 @@ EuclideanClusterNode::EuclideanClusterNode(var params) :
 	inHighres = addSlot("In High Resolution", true, POINTCLOUD);
 	out = addSlot("Out", false, CLUSTERS);
 
+	clusterMode = addEnumParameter("Mode", "Clustering algorithm. KD-Tree is the most generic, Organized works in image space on clouds coming straight from a camera (fastest), Voxel Hash gives the same clusters as KD-Tree with a sorted voxel grid, faster on unorganized clouds");
+	clusterMode->addOption("KD-Tree", KDTREE)->addOption("Organized", ORGANIZED)->addOption("Voxel Hash", VOXEL_HASH);
+
 	tolerance = addFloatParameter("Tolerance", "The neighbour distance to tolerate when searching neighbours for clustering. In meters", .02f, .001f);
 	minCount = addIntParameter("Min Count", "The minimum amount of points that a cluster can have", 100);
 	maxCount = addIntParameter("Max count", "The maximum amount of points that a cluster can have", 25000);
@@ -36,28 +39,112 @@ EuclideanClusterNode::~EuclideanClusterNode()
 
 void EuclideanClusterNode::processInternal()
 {
-	CloudPtr source = slotCloudMap[in];
-	CloudPtr sourceHires = slotCloudMap[inHighres];
+	CloudPtr cloud = slotCloudMap[in];
+	CloudPtr hiResCloud = slotCloudMap[inHighres];
+
+	if (cloud == nullptr || cloud->empty()) return;
+	if (hiResCloud != nullptr && hiResCloud->empty()) hiResCloud = nullptr;
 
-	if (source->empty()) return;
-	
-	CloudPtr cloud(new Cloud());
-	pcl::copyPointCloud(*source, *cloud);
+	//input clouds are only read here, no need to copy them
+	NNLOG("Start extract, num input points : " << (int)cloud->size());
 
-	CloudPtr hiResCloud = nullptr;
+	std::vector<pcl::PointIndices> clusterIndices;
 
-	if (sourceHires != nullptr && !sourceHires->empty())
+	ClusterMode mode = clusterMode->getValueDataAsEnum<ClusterMode>();
+	if (mode == ORGANIZED && !cloud->isOrganized())
 	{
-		hiResCloud.reset(new Cloud());
-		pcl::copyPointCloud(*sourceHires, *hiResCloud);
+		NNLOG("Input cloud is not organized, using Voxel Hash mode");
+		mode = VOXEL_HASH;
 	}
 
-	NNLOG("Start extract, num input points : " << (int)cloud->size());
+	switch (mode)
+	{
+	case KDTREE: if (!extractKdTree(cloud, clusterIndices)) return; break;
+	case ORGANIZED: extractOrganized(cloud, clusterIndices); break;
+	case VOXEL_HASH: extractVoxelHash(cloud, clusterIndices); break;
+	}
+
+	NNLOG("Extracted, num clusters : " << (int)clusterIndices.size());
+
+	if (out->isEmpty()) return;
+
+	bool compute = computeBox->boolValue();
+	Vector3D<float> minS(minSize->x, minSize->y, minSize->z);
+	Vector3D<float> maxS(maxSize->x, maxSize->y, maxSize->z);
+
+	//built once, then each cluster only looks at the cells that overlap its box
+	if (hiResCloud != nullptr) hiResGrid.build(hiResCloud);
+
+	//each cluster is independant, filled in parallel then kept in extraction order
+	std::vector<ClusterPtr> results(clusterIndices.size());
+
+	pleiades::parallelFor((int)clusterIndices.size(), [&](int index)
+		{
+			const std::vector<int>& indices = clusterIndices[index].indices;
+			const int numPoints = (int)indices.size();
+			if (numPoints == 0) return;
+
+			CloudPtr c(new Cloud(numPoints, 1));
+
+			//bounds and sum as 4-float SIMD reductions
+			Eigen::Array4f minP = Eigen::Array4f::Constant(std::numeric_limits<float>::max());
+			Eigen::Array4f maxP = Eigen::Array4f::Constant(std::numeric_limits<float>::lowest());
+			Eigen::Array4f sum = Eigen::Array4f::Zero();
+
+			for (int i = 0; i < numPoints; i++)
+			{
+				const PPoint& p = cloud->points[indices[i]];
+				Eigen::Array4f v = p.getArray4fMap();
+				minP = minP.min(v);
+				maxP = maxP.max(v);
+				sum += v;
+				c->points[i] = p;
+			}
+
+			c->is_dense = true;
+
+			Vector3D<float> boundsMin(minP[0], minP[1], minP[2]);
+			Vector3D<float> boundsMax(maxP[0], maxP[1], maxP[2]);
+			Vector3D<float> clusterSize = boundsMax - boundsMin;
+
+			if (clusterSize.x < minS.x || clusterSize.y < minS.y || clusterSize.z < minS.z
+				|| clusterSize.x > maxS.x || clusterSize.y > maxS.y || clusterSize.z > maxS.z) return;
+
+			CloudPtr cc = c;
+			if (hiResCloud != nullptr)
+			{
+				cc.reset(new Cloud());
+				hiResGrid.getPointsInBox(boundsMin, boundsMax, *cc);
+			}
+
+			ClusterPtr pc(new Cluster(0, cc));
+			if (compute)
+			{
+				sum /= (float)numPoints;
+				pc->boundingBoxMin = boundsMin;
+				pc->boundingBoxMax = boundsMax;
+				pc->centroid = Vector3D<float>(sum[0], sum[1], sum[2]);
+			}
+
+			results[index] = pc;
+		});
+
+	Array<ClusterPtr> clusters;
+	for (auto& pc : results)
+	{
+		if (pc == nullptr) continue;
+		pc->id = clusters.size();
+		clusters.add(pc);
+	}
+
+	sendClusters(out, clusters);
+}
 
+bool EuclideanClusterNode::extractKdTree(CloudPtr cloud, std::vector<pcl::PointIndices>& clusterIndices)
+{
 	pcl::search::KdTree<PPoint>::Ptr tree(new pcl::search::KdTree<PPoint>);
 	tree->setInputCloud(cloud);
 
-	std::vector<pcl::PointIndices> clusterIndices;
 	pcl::EuclideanClusterExtraction<pcl::PointXYZ> ec;
 	ec.setClusterTolerance(tolerance->floatValue());
 	ec.setMinClusterSize(minCount->intValue());
@@ -72,92 +159,224 @@ void EuclideanClusterNode::processInternal()
 	catch (...)
 	{
 		NLOGERROR(niceName, "Error trying to extract clusters");
-		return;
+		return false;
 	}
 
-	NNLOG("Extracted, num clusters : " << (int)clusterIndices.size());
-
-	if (out->isEmpty()) return;
+	return true;
+}
 
-	bool compute = computeBox->boolValue();
+void EuclideanClusterNode::extractOrganized(CloudPtr cloud, std::vector<pcl::PointIndices>& clusterIndices)
+{
+	//connected components in image space, two pixels are connected if they are neighbours in the image and closer than tolerance in 3d.
+	//only the 4 already visited neighbours (left, up-left, up, up-right) are checked, which is enough to cover the 8-neighbourhood
+	const int w = cloud->width;
+	const int h = cloud->height;
+	const int numPoints = w * h;
+	const float tol2 = tolerance->floatValue() * tolerance->floatValue();
+	const PPoint* points = cloud->points.data();
 
-	Array<ClusterPtr> clusters;
-	for (std::vector<pcl::PointIndices>::const_iterator it = clusterIndices.begin(); it != clusterIndices.end(); ++it)
-	{
-		CloudPtr c(new Cloud());
+	labels.resize(numPoints);
 
-		Vector3D<float> minP(INT32_MAX, INT32_MAX, INT32_MAX);
-		Vector3D<float> maxP(INT32_MIN, INT32_MIN, INT32_MIN);
-		Vector3D<float> average(0, 0, 0);
+	const int dx[4] = { -1, -1, 0, 1 };
+	const int dy[4] = { 0, -1, -1, -1 };
 
-		for (const auto& idx : it->indices)
+	for (int y = 0; y < h; y++)
+	{
+		for (int x = 0; x < w; x++)
 		{
+			int i = y * w + x;
+			const PPoint& p = points[i];
+
+			//cameras give 0,0,0 or NaN when there is no depth
+			if (!pcl::isFinite(p) || (p.x == 0 && p.y == 0 && p.z == 0))
+			{
+				labels[i] = -1;
+				continue;
+			}
 
-			PPoint p = (*cloud)[idx];
+			labels[i] = i;
 
-			if (compute)
+			for (int n = 0; n < 4; n++)
 			{
-				minP.x = jmin(p.x, minP.x);
-				minP.y = jmin(p.y, minP.y);
-				minP.z = jmin(p.z, minP.z);
+				int nx = x + dx[n];
+				int ny = y + dy[n];
+				if (nx < 0 || nx >= w || ny < 0) continue;
 
-				maxP.x = jmax(p.x, maxP.x);
-				maxP.y = jmax(p.y, maxP.y);
-				maxP.z = jmax(p.z, maxP.z);
+				int ni = ny * w + nx;
+				if (labels[ni] < 0) continue;
+				if ((points[ni].getVector3fMap() - p.getVector3fMap()).squaredNorm() > tol2) continue;
 
-				average += Vector3D(p.x, p.y, p.z);
+				joinLabels(labels, i, ni);
 			}
-
-			c->push_back(p); //*
 		}
+	}
 
-		c->width = c->size();
-		c->height = 1;
-		c->is_dense = true;
+	labelsToIndices(numPoints, clusterIndices);
+}
 
+void EuclideanClusterNode::extractVoxelHash(CloudPtr cloud, std::vector<pcl::PointIndices>& clusterIndices)
+{
+	//voxels of tolerance / sqrt(3), so all the points of a voxel are within tolerance of each other.
+	//neighbour voxels are only joined when two of their points actually are within tolerance
+	const int numPoints = (int)cloud->size();
+	const float tol = tolerance->floatValue();
+	const float tol2 = tol * tol;
+	const float invVoxelSize = std::sqrt(3.0f) / tol;
+	const int64 offset = 1 << 20;
 
-		Vector3D<float> boundsMin = Vector3D<float>(minP.x, minP.y, minP.z);;
-		Vector3D<float> boundsMax = Vector3D<float>(maxP.x, maxP.y, maxP.z);;
+	auto getKey = [offset](int64 x, int64 y, int64 z) { return ((x + offset) << 42) | ((y + offset) << 21) | (z + offset); };
 
-		Vector3D<float> clusterSize = boundsMax - boundsMin;
+	labels.resize(numPoints);
+	sortedVoxelPoints.clear();
 
-		if (clusterSize.x < minSize->x || clusterSize.y < minSize->y || clusterSize.z < minSize->z
-			|| clusterSize.x > maxSize->x || clusterSize.y > maxSize->y || clusterSize.z > maxSize->z) continue;
-		
+	for (int i = 0; i < numPoints; i++)
+	{
+		const PPoint& p = cloud->points[i];
+		if (!pcl::isFinite(p))
+		{
+			labels[i] = -1;
+			continue;
+		}
 
-	
+		labels[i] = i;
+		sortedVoxelPoints.push_back({ getKey((int64)std::floor(p.x * invVoxelSize), (int64)std::floor(p.y * invVoxelSize), (int64)std::floor(p.z * invVoxelSize)), i });
+	}
 
-		CloudPtr cc = nullptr;
+	std::sort(sortedVoxelPoints.begin(), sortedVoxelPoints.end());
 
-		if (hiResCloud != nullptr)
-		{
-			cc.reset(new Cloud());
+	//first entry of each voxel in sortedVoxelPoints, plus the end
+	const int numSorted = (int)sortedVoxelPoints.size();
+	voxelStarts.clear();
+	for (int s = 0; s < numSorted; s++)
+	{
+		if (s == 0 || sortedVoxelPoints[s].first != sortedVoxelPoints[s - 1].first) voxelStarts.push_back(s);
+		else labels[sortedVoxelPoints[s].second] = sortedVoxelPoints[voxelStarts.back()].second; //same voxel, joined to its first point
+	}
+	voxelStarts.push_back(numSorted);
 
-			pcl::CropBox<pcl::PointXYZ> filter;
-			filter.setInputCloud(hiResCloud);
-			filter.setMin(Eigen::Vector4f(boundsMin.x, boundsMin.y, boundsMin.z, 1));
-			filter.setMax(Eigen::Vector4f(boundsMax.x, boundsMax.y, boundsMax.z, 1));
-			filter.filter(*cc);
-		}
-		else
+	auto areVoxelsClose = [&](int start, int end, int nStart, int nEnd)
+	{
+		for (int a = start; a < end; a++)
 		{
-			cc = c;
+			Eigen::Vector3f pa = cloud->points[sortedVoxelPoints[a].second].getVector3fMap();
+			for (int b = nStart; b < nEnd; b++)
+			{
+				if ((cloud->points[sortedVoxelPoints[b].second].getVector3fMap() - pa).squaredNorm() <= tol2) return true;
+			}
 		}
+		return false;
+	};
 
-		ClusterPtr pc(new Cluster(clusters.size(), cc));
-		if (compute)
+	//points within tolerance can be up to 2 voxels apart on each axis. Only the neighbours that come after in key order
+	//are checked, the others do the same with this one
+	for (int v = 0; v < (int)voxelStarts.size() - 1; v++)
+	{
+		const int start = voxelStarts[v];
+		const int end = voxelStarts[v + 1];
+		const int first = sortedVoxelPoints[start].second;
+
+		int64 key = sortedVoxelPoints[start].first;
+		int64 vx = (key >> 42) - offset;
+		int64 vy = ((key >> 21) & ((1 << 21) - 1)) - offset;
+		int64 vz = (key & ((1 << 21) - 1)) - offset;
+
+		for (int ox = 0; ox <= 2; ox++)
 		{
-			average /= it->indices.size();
-			pc->boundingBoxMin = boundsMin;
-			pc->boundingBoxMax = boundsMax;
+			for (int oy = -2; oy <= 2; oy++)
+			{
+				for (int oz = -2; oz <= 2; oz++)
+				{
+					if (ox == 0 && (oy < 0 || (oy == 0 && oz <= 0))) continue;
+
+					//closest distance between the two voxels, in voxels, squared. Tolerance is sqrt(3) voxels
+					int gx = jmax(ox - 1, 0);
+					int gy = jmax(std::abs(oy) - 1, 0);
+					int gz = jmax(std::abs(oz) - 1, 0);
+					if (gx * gx + gy * gy + gz * gz > 3) continue;
+
+					int64 nKey = getKey(vx + ox, vy + oy, vz + oz);
+					auto it = std::lower_bound(sortedVoxelPoints.begin(), sortedVoxelPoints.end(), std::make_pair(nKey, 0));
+					if (it == sortedVoxelPoints.end() || it->first != nKey) continue;
+
+					int nStart = (int)(it - sortedVoxelPoints.begin());
+					if (findRoot(labels, first) == findRoot(labels, it->second)) continue;
+
+					int nEnd = nStart + 1;
+					while (nEnd < numSorted && sortedVoxelPoints[nEnd].first == nKey) nEnd++;
+
+					if (areVoxelsClose(start, end, nStart, nEnd)) joinLabels(labels, first, it->second);
+				}
+			}
+		}
+	}
+
+	labelsToIndices(numPoints, clusterIndices);
+}
+
+void EuclideanClusterNode::labelsToIndices(int numPoints, std::vector<pcl::PointIndices>& clusterIndices)
+{
+	const int minC = minCount->intValue();
+	const int maxC = maxCount->intValue();
+
+	//count points per root label
+	clusterForLabel.assign(numPoints, 0);
+	for (int i = 0; i < numPoints; i++)
+	{
+		if (labels[i] < 0) continue;
+		labels[i] = findRoot(labels, i);
+		clusterForLabel[labels[i]]++;
+	}
+
+	//assign a cluster to each root with a valid count, -1 for the others
+	for (int i = 0; i < numPoints; i++)
+	{
+		if (labels[i] != i) continue;
 
-			pc->centroid = Vector3D<float>(average.x, average.y, average.z);;
+		int count = clusterForLabel[i];
+		if (count < minC || count > maxC)
+		{
+			clusterForLabel[i] = -1;
+			continue;
 		}
 
-		clusters.add(pc);
+		clusterForLabel[i] = (int)clusterIndices.size();
+		clusterIndices.emplace_back();
+		clusterIndices.back().indices.reserve(count);
 	}
 
-	sendClusters(out, clusters);
+	for (int i = 0; i < numPoints; i++)
+	{
+		if (labels[i] < 0) continue;
+		int c = clusterForLabel[labels[i]];
+		if (c >= 0) clusterIndices[c].indices.push_back(i);
+	}
+}
+
+int EuclideanClusterNode::findRoot(std::vector<int>& parents, int i)
+{
+	int root = i;
+	while (parents[root] != root) root = parents[root];
+
+	//path compression
+	while (parents[i] != root)
+	{
+		int next = parents[i];
+		parents[i] = root;
+		i = next;
+	}
+
+	return root;
+}
+
+void EuclideanClusterNode::joinLabels(std::vector<int>& parents, int a, int b)
+{
+	int ra = findRoot(parents, a);
+	int rb = findRoot(parents, b);
+	if (ra == rb) return;
+
+	//keep the smallest index as root so roots are always the first point of their cluster
+	if (ra < rb) parents[rb] = ra;
+	else parents[ra] = rb;
 }
 
 void EuclideanClusterNode::onContainerParameterChangedInternal(Parameter* p)
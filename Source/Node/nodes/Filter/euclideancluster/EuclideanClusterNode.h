@@ -21,6 +21,8 @@ public:
     NodeConnectionSlot* inHighres;
     NodeConnectionSlot* out;
 
+    enum ClusterMode { KDTREE, ORGANIZED, VOXEL_HASH };
+    EnumParameter* clusterMode;
     FloatParameter * tolerance;
     IntParameter* minCount;
     IntParameter * maxCount;
@@ -28,8 +30,23 @@ public:
     Point3DParameter* maxSize;
     BoolParameter* computeBox;
 
+    //reused between frames
+    std::vector<int> labels;
+    std::vector<int> clusterForLabel;
+    PointGrid hiResGrid;
+    std::vector<std::pair<int64, int>> sortedVoxelPoints; //voxel key, point index
+    std::vector<int> voxelStarts;
+
     void processInternal() override;
 
+    bool extractKdTree(CloudPtr cloud, std::vector<pcl::PointIndices>& clusterIndices);
+    void extractOrganized(CloudPtr cloud, std::vector<pcl::PointIndices>& clusterIndices);
+    void extractVoxelHash(CloudPtr cloud, std::vector<pcl::PointIndices>& clusterIndices);
+    void labelsToIndices(int numPoints, std::vector<pcl::PointIndices>& clusterIndices);
+
+    static int findRoot(std::vector<int>& parents, int i);
+    static void joinLabels(std::vector<int>& parents, int a, int b);
+
     void onContainerParameterChangedInternal(Parameter* p) override;
     void onContainerTriggerTriggered(Trigger* t) override;
 
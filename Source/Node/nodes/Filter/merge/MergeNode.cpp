@@ -9,11 +9,22 @@
 */
 
 MergeNode::MergeNode(var params) :
-	Node(getTypeString(), FILTER, params)
+	Node(getTypeString(), FILTER, params),
+	transformsContainer("Input Transforms")
 {
+	saveAndLoadRecursiveData = true;
+
 	for (int i = 0; i < 8; i++) ins.add(addSlot("In " + String(i + 1), true, POINTCLOUD));
 	out = addSlot("Merged", false, POINTCLOUD);
 
+	for (int i = 0; i < ins.size(); i++)
+	{
+		InputTransform* t = new InputTransform(i);
+		inputTransforms.add(t);
+		transformsContainer.addChildControllableContainer(t);
+	}
+	addChildControllableContainer(&transformsContainer);
+
 	processOnlyOnce = true;
 	processOnlyWhenAllConnectedNodesHaveProcessed = true;
 }
@@ -28,17 +39,67 @@ void MergeNode::processInternal()
 
 	if (!out->isEmpty())
 	{
-		CloudPtr outC(new Cloud());
-
+		//sizes first, so the merged cloud is allocated once and each input is copied to its own range
 		StringArray mergedSlots;
+		Array<CloudPtr> sources;
+		Array<int> sourceTransforms;
+		transforms.clear();
+		int totalPoints = 0;
+		bool isDense = true;
+
 		for (int i = 0; i < ins.size(); i++)
 		{
 			CloudPtr c = slotCloudMap[ins[i]];
 			if (c == nullptr) continue;
-			*outC += *c;
+
+			sources.add(c);
+			totalPoints += (int)c->size();
+			isDense &= c->is_dense;
 			mergedSlots.add(String(i + 1));
+
+			InputTransform* it = inputTransforms[i];
+			if (it->apply->boolValue())
+			{
+				sourceTransforms.add((int)transforms.size());
+				transforms.push_back(pleiades::makeTransform(it->translate->getVector(), it->rotate->getVector(), it->scale->getVector()));
+			}
+			else sourceTransforms.add(-1);
 		}
 
+		CloudPtr outC = cloudPool.getCloud(totalPoints, 1);
+		outC->is_dense = isDense;
+
+		//split in blocks so big inputs are spread over the workers too
+		const int blockSize = 16384;
+		copyJobs.clear();
+		PPoint* dest = outC->points.data();
+		for (int s = 0; s < sources.size(); s++)
+		{
+			const PPoint* src = sources[s]->points.data();
+			int numPoints = (int)sources[s]->size();
+			for (int start = 0; start < numPoints; start += blockSize)
+			{
+				copyJobs.push_back({ src + start, dest + start, jmin(blockSize, numPoints - start), sourceTransforms[s] });
+			}
+			dest += numPoints;
+		}
+
+		pleiades::parallelFor((int)copyJobs.size(), [this](int j)
+			{
+				const CopyJob& job = copyJobs[j];
+				if (job.transformIndex == -1)
+				{
+					memcpy(job.dest, job.source, job.numPoints * sizeof(PPoint));
+					return;
+				}
+
+				const Eigen::Affine3f& t = transforms[job.transformIndex];
+				for (int i = 0; i < job.numPoints; i++)
+				{
+					job.dest[i].getVector3fMap() = t * job.source[i].getVector3fMap();
+					job.dest[i].data[3] = 1;
+				}
+			});
 
 		NNLOG("Merged " << mergedSlots.size() << " (" << mergedSlots.joinIntoString(",") << "), total points : " << outC->size());
 
@@ -46,9 +107,24 @@ void MergeNode::processInternal()
 	}
 }
 
+MergeNode::InputTransform::InputTransform(int index) :
+	ControllableContainer("In " + String(index + 1))
+{
+	apply = addBoolParameter("Apply", "If checked, this input is transformed while being merged", false);
+	translate = addPoint3DParameter("Translate", "Translate the cloud");
+	rotate = addPoint3DParameter("Rotate", "Rotate the cloud");
+	scale = addPoint3DParameter("Scale", "Scale the cloud");
+	var v;
+	v.append(1);
+	v.append(1);
+	v.append(1);
+	scale->setDefaultValue(v);
+}
+
 MergeClustersNode::MergeClustersNode(var params) :
 	Node(getTypeString(), FILTER, params),
-	mergeIDIncrement(0)
+	mergeIDIncrement(0),
+	cellSize(1)
 {
 	for (int i = 0; i < 8; i++) ins.add(addSlot("In " + String(i + 1), true, CLUSTERS));
 	out = addSlot("Merged", false, CLUSTERS);
@@ -76,6 +152,7 @@ void MergeClustersNode::onContainerTriggerTriggered(Trigger* t)
 	{
 		mergeIDIncrement = 0;
 		mergedClusters.clear();
+		sourceIndex.clear();
 	}
 }
 
@@ -85,6 +162,8 @@ void MergeClustersNode::processInternal()
 	float _mergeDist = mergeDistance->floatValue();
 	float _detachDist = detachDistance->floatValue();
 
+	buildSourceIndex();
+
 	for (int i = 0; i < ins.size(); i++)
 	{
 		Array<ClusterPtr> sourceClusters = slotClustersMap[ins[i]];
@@ -101,6 +180,7 @@ void MergeClustersNode::processInternal()
 
 				MergedCluster* mCluster = new MergedCluster(mergeIDIncrement++, newSource, autoClearTime->enabled ? autoClearTime->floatValue() * 1000 : 0);
 				mergedClusters.add(mCluster);
+				sourceIndex.set(getSourceKey(i, c->id), mCluster);
 
 				NNLOG("Add cluster " << mCluster->id);
 				//DBG("Create new Merged, new size : " << mergedClusters.size());
@@ -127,6 +207,7 @@ void MergeClustersNode::processInternal()
 				{
 					//DBG("Remove merged cluster");
 					mCluster->removeSource(newSource);
+					sourceIndex.remove(getSourceKey(i, c->id));
 					if (mCluster->sourceClusters.size() == 0)
 					{
 						//DBG("Merged cluster is empty, before remove : " << mergedClusters.size());
@@ -140,33 +221,7 @@ void MergeClustersNode::processInternal()
 
 	//merging
 	HashMap<MergedCluster*, MergedCluster*> mergeMap;
-	for (int i = 0; i < mergedClusters.size(); i++)
-	{
-		MergedCluster* mg1 = mergedClusters[i];
-
-		if (_mergeOnlyOnEnter && mg1->state != Cluster::ENTERED) continue;
-		if (mergeMap.containsValue(mg1)) continue;
-
-		float closestDist = INT32_MAX;
-		MergedCluster* closestMerged = nullptr;
-
-		for (int j = i + 1; j < mergedClusters.size(); j++)
-		{
-			MergedCluster* mg2 = mergedClusters[j];
-			if (mergeMap.containsValue(mg2)) continue;
-			if (mg1->hasCommonSourceWith(mg2)) continue;
-
-			float dist = (mg1->centroid - mg2->centroid).length();
-			if (dist < _mergeDist && dist < closestDist)
-			{
-				closestDist = dist;
-				closestMerged = mg2;
-			}
-		}
-
-		if (closestMerged != nullptr) mergeMap.set(mg1, closestMerged);
-	}
-
+	findMerges(mergeMap, _mergeOnlyOnEnter, _mergeDist);
 
 	HashMap<MergedCluster*, MergedCluster*>::Iterator it(mergeMap);
 	Array<MergedCluster*> clustersToRemove;
@@ -189,7 +244,7 @@ void MergeClustersNode::processInternal()
 
 	//sending
 	outClusters.clear();
-	for (auto& c : mergedClusters) outClusters.add(ClusterPtr(new Cluster(*c))); //Copy to new ClusterPtr for sending through connection
+	for (auto& c : mergedClusters) outClusters.add(ClusterPtr(new Cluster(*c))); //Copy the values to a new ClusterPtr for sending through connection, points are shared
 
 	//NNLOG("Sending " << outClusters.size() << " merged clusters");
 	sendClusters(out, outClusters);
@@ -207,13 +262,101 @@ void MergeClustersNode::processInternal()
 
 MergeClustersNode::SourceClusterPtr MergeClustersNode::getMergedSourceClusterForNewSource(SourceClusterPtr newSource)
 {
-	//DBG("Get merged for new source, source ID :" << newSource->sourceID << ", num merged : " << mergedClusters.size());
-	for (auto& m : mergedClusters) if (SourceClusterPtr s = m->getSourceForCluster(newSource)) return s;
-	return nullptr;
+	int64 key = getSourceKey(newSource->sourceID, newSource->cluster->id);
+	if (!sourceIndex.contains(key)) return nullptr;
+	return sourceIndex[key]->getSourceForCluster(newSource);
+}
+
+void MergeClustersNode::buildSourceIndex()
+{
+	//merged clusters may have been removed or auto cleared since last frame, start from what is there
+	sourceIndex.clear();
+	for (auto& m : mergedClusters)
+	{
+		HashMap<int, SourceClusterPtr>::Iterator it(m->sourceClusters);
+		while (it.next()) sourceIndex.set(getSourceKey(it.getKey(), it.getValue()->cluster->id), m);
+	}
+}
+
+void MergeClustersNode::findMerges(HashMap<MergedCluster*, MergedCluster*>& mergeMap, bool mergeOnlyOnEnter, float mergeDist)
+{
+	int numMerged = mergedClusters.size();
+	cellSize = jmax(mergeDist, .01f);
+
+	sortedCentroids.resize(numMerged);
+	sourceMasks.resize(numMerged);
+	isMergeTarget.assign(numMerged, 0);
+
+	for (int i = 0; i < numMerged; i++)
+	{
+		MergedCluster* m = mergedClusters[i];
+		const Vector3D<float>& p = m->centroid;
+		sortedCentroids[i] = { getCellKey(getCellCoord(p.x), getCellCoord(p.y), getCellCoord(p.z)), i };
+
+		uint32 mask = 0;
+		HashMap<int, SourceClusterPtr>::Iterator it(m->sourceClusters);
+		while (it.next()) mask |= 1u << (it.getKey() & 31);
+		sourceMasks[i] = mask;
+	}
+	std::sort(sortedCentroids.begin(), sortedCentroids.end());
+
+	//same pairing as comparing every pair in order : each cluster takes the closest later one that is not already taken
+	for (int i = 0; i < numMerged; i++)
+	{
+		MergedCluster* mg1 = mergedClusters[i];
+
+		if (mergeOnlyOnEnter && mg1->state != Cluster::ENTERED) continue;
+		if (isMergeTarget[i]) continue;
+
+		float closestDist = INT32_MAX;
+		int closestIndex = -1;
+
+		const Vector3D<float>& p = mg1->centroid;
+		int cx = getCellCoord(p.x);
+		int cy = getCellCoord(p.y);
+		int cz = getCellCoord(p.z);
+
+		for (int x = cx - 1; x <= cx + 1; x++)
+		{
+			for (int y = cy - 1; y <= cy + 1; y++)
+			{
+				for (int z = cz - 1; z <= cz + 1; z++)
+				{
+					int64 key = getCellKey(x, y, z);
+					auto it = std::lower_bound(sortedCentroids.begin(), sortedCentroids.end(), std::make_pair(key, 0));
+					for (; it != sortedCentroids.end() && it->first == key; it++)
+					{
+						int j = it->second;
+						if (j <= i || isMergeTarget[j]) continue;
+						if (sourceMasks[i] & sourceMasks[j]) continue;
+
+						float dist = (p - mergedClusters[j]->centroid).length();
+						if (dist < mergeDist && (dist < closestDist || (dist == closestDist && j < closestIndex)))
+						{
+							closestDist = dist;
+							closestIndex = j;
+						}
+					}
+				}
+			}
+		}
+
+		if (closestIndex != -1)
+		{
+			mergeMap.set(mg1, mergedClusters[closestIndex]);
+			isMergeTarget[closestIndex] = 1;
+		}
+	}
+}
+
+int64 MergeClustersNode::getCellKey(int x, int y, int z) const
+{
+	const int64 offset = 1 << 20;
+	return ((x + offset) << 42) | ((y + offset) << 21) | (z + offset);
 }
 
 MergeClustersNode::MergedCluster::MergedCluster(int id, MergeClustersNode::SourceClusterPtr firstSource, uint32 autoClearTime) :
-	Cluster(id, CloudPtr(new Cloud())),
+	Cluster(id, nullptr),
 	autoClearTime(autoClearTime)
 {
 	addSource(firstSource);
@@ -272,8 +415,9 @@ void MergeClustersNode::MergedCluster::update()
 		return;
 	}
 
-	CloudPtr newCloud(new Cloud());
-	ClusterPtr newCluster(new Cluster(id, newCloud));
+	//source clouds are only referenced, they are concatenated if a consumer asks for the points
+	std::shared_ptr<CloudSegments> segments(new CloudSegments());
+	ClusterPtr newCluster(new Cluster(id, nullptr));
 
 
 	newCluster->boundingBoxMin = Vector3D<float>(INT32_MAX, INT32_MAX, INT32_MAX);
@@ -301,7 +445,7 @@ void MergeClustersNode::MergedCluster::update()
 			continue;
 		}
 
-		*newCloud += *source->cluster->cloud;
+		source->cluster->appendPointsTo(*segments);
 
 		newCluster->boundingBoxMin = Vector3D<float>(jmin(newCluster->boundingBoxMin.x, source->cluster->boundingBoxMin.x), jmin(newCluster->boundingBoxMin.y, source->cluster->boundingBoxMin.y), jmin(newCluster->boundingBoxMin.z, source->cluster->boundingBoxMin.z));
 
@@ -325,6 +469,7 @@ void MergeClustersNode::MergedCluster::update()
 		newCluster->velocity /= sourceClusters.size();
 	}
 
+	newCluster->setCloudSegments(segments);
 	Cluster::update(newCluster);
 
 	if (sourceClusters.size() == 0) state = WILL_LEAVE;
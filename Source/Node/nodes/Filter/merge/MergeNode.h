@@ -20,6 +20,34 @@ public:
 	Array<NodeConnectionSlot*> ins;
 	NodeConnectionSlot* out;
 
+	//applied while copying, to place each camera in a common space without separate transform nodes
+	class InputTransform :
+		public ControllableContainer
+	{
+	public:
+		InputTransform(int index);
+
+		BoolParameter* apply;
+		Point3DParameter* translate;
+		Point3DParameter* rotate;
+		Point3DParameter* scale;
+	};
+
+	ControllableContainer transformsContainer;
+	OwnedArray<InputTransform> inputTransforms;
+
+	struct CopyJob
+	{
+		const PPoint* source;
+		PPoint* dest;
+		int numPoints;
+		int transformIndex; //-1 for a plain copy
+	};
+
+	CloudPool cloudPool;
+	std::vector<CopyJob> copyJobs;
+	std::vector<Eigen::Affine3f, Eigen::aligned_allocator<Eigen::Affine3f>> transforms;
+
 	void processInternal() override;
 
 	String getTypeString() const override { return getTypeStringStatic(); }
@@ -85,11 +113,26 @@ public:
 	OwnedArray<MergedCluster, CriticalSection> mergedClusters;
 	Array<ClusterPtr> outClusters;
 
+	//(source ID, cluster ID) -> merged cluster holding it, rebuilt each frame and kept up to date while sources are processed
+	HashMap<int64, MergedCluster*> sourceIndex;
+
+	//merge candidates come from a uniform grid over the centroids, with cells of merge distance size
+	float cellSize;
+	std::vector<std::pair<int64, int>> sortedCentroids; //cell key, merged cluster index
+	std::vector<uint32> sourceMasks; //one bit per input
+	std::vector<uint8> isMergeTarget;
+
 	void onContainerTriggerTriggered(Trigger* t) override;
 
 	void processInternal() override;
 
 	SourceClusterPtr getMergedSourceClusterForNewSource(SourceClusterPtr newSource);
+	void buildSourceIndex();
+	void findMerges(HashMap<MergedCluster*, MergedCluster*>& mergeMap, bool mergeOnlyOnEnter, float mergeDist);
+
+	static int64 getSourceKey(int sourceID, int clusterID) { return ((int64)sourceID << 32) | (uint32)clusterID; }
+	int64 getCellKey(int x, int y, int z) const;
+	int getCellCoord(float v) const { return (int)std::floor(v / cellSize); }
 
 
 	String getTypeString() const override { return getTypeStringStatic(); }
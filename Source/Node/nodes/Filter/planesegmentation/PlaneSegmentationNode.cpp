@@ -46,39 +46,54 @@ void PlaneSegmentationNode::processInternal()
 
 	int ds = downSample->intValue();
 
+	//the input is only modified when no other node reads it
+	bool ownsSource = canWriteInputInPlace(in, source);
 
-	if (cleanUp->boolValue())
+	//when fused, the clean up was already done by the point chain before this node
+	if (cleanUp->boolValue() && !areInputStagesRunUpstream())
 	{
-		source->erase(std::remove_if(source->points.begin(), source->points.end(), [](PPoint p) { return (p.x == 0 && p.y == 0 && p.z == 0) || std::isinf(p.x) || std::isinf(p.y) || std::isinf(p.z); }), source->points.end());
+		auto isBad = [](const PPoint& p) { return (p.x == 0 && p.y == 0 && p.z == 0) || std::isinf(p.x) || std::isinf(p.y) || std::isinf(p.z); };
+		if (ownsSource)
+		{
+			source->erase(std::remove_if(source->points.begin(), source->points.end(), isBad), source->points.end());
+		}
+		else
+		{
+			CloudPtr cleaned = cleanUpPool.getCloud((int)source->size(), 1);
+			pleiades::copyPointsIf(*source, *cleaned, [&isBad](const PPoint& p) { return !isBad(p); });
+			source = cleaned;
+			ownsSource = true;
+		}
 	}
 
-	CloudPtr cloud(new Cloud());
-	if (ds == 1) pcl::copyPointCloud(*source, *cloud);
-	else
+	if (continuous->boolValue() || findOnNextProcess)
 	{
-		if (source->isOrganized())
+		//the segmentation only reads the cloud, the source is used as is when not down sampled
+		CloudPtr cloud = source;
+		if (ds > 1)
 		{
-			cloud.reset(new Cloud(ceil(source->width * 1.0f / ds), ceil(source->height * 1.0f / ds)));
-
-			for (int ty = 0; ty < (int)source->height; ty += ds)
+			if (source->isOrganized())
 			{
-				for (int tx = 0; tx < (int)source->width; tx += ds)
+				cloud.reset(new Cloud(ceil(source->width * 1.0f / ds), ceil(source->height * 1.0f / ds)));
+
+				for (int ty = 0; ty < (int)source->height; ty += ds)
 				{
-					cloud->at(floor(tx / ds), floor(ty / ds)) = source->at(tx, ty);
+					for (int tx = 0; tx < (int)source->width; tx += ds)
+					{
+						cloud->at(floor(tx / ds), floor(ty / ds)) = source->at(tx, ty);
+					}
 				}
 			}
-		}
-		else
-		{
-			for (int i = 0; i < source->size(); i += ds)
+			else
 			{
-				cloud->push_back(source->points[i]);
+				cloud.reset(new Cloud());
+				for (int i = 0; i < source->size(); i += ds)
+				{
+					cloud->push_back(source->points[i]);
+				}
 			}
 		}
-	}
 
-	if (continuous->boolValue() || findOnNextProcess)
-	{
 		reproj = Eigen::Quaternionf::Identity();
 
 		NNLOG("Finding plane..");
@@ -131,8 +146,9 @@ void PlaneSegmentationNode::processInternal()
 			extract.setInputCloud(cloud);
 			extract.setIndices(inliers);
 			if (invertDetection->boolValue()) extract.setNegative(true);
-			extract.filterDirectly(cloud);
-			sendPointCloud(planeCloud, cloud);
+			CloudPtr planePoints(new Cloud());
+			extract.filter(*planePoints);
+			sendPointCloud(planeCloud, planePoints);
 		}
 
 		findOnNextProcess = false;
@@ -149,9 +165,7 @@ void PlaneSegmentationNode::processInternal()
 	{
 		if (transformPlane->boolValue())
 		{
-			CloudPtr transformedCloud(new Cloud(source->width, source->height));
-			pcl::transformPointCloud(*source, *transformedCloud, transform);
-			sendPointCloud(out, transformedCloud);
+			sendPointCloud(out, transformer.transform(source, transform, ownsSource));
 		}
 		else
 		{
@@ -165,6 +179,11 @@ void PlaneSegmentationNode::processInternal()
 	sendTransform(outTransform, transform);
 }
 
+void PlaneSegmentationNode::addInputPointStages(PointKernel& kernel)
+{
+	if (cleanUp->boolValue()) kernel.addCleanUp(true);
+}
+
 var PlaneSegmentationNode::getJSONData()
 {
 	var data = Node::getJSONData();
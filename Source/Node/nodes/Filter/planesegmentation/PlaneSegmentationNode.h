@@ -40,8 +40,14 @@ public:
 
     bool findOnNextProcess;
 
+    CloudTransformer transformer;
+    CloudPool cleanUpPool;
+
     void processInternal() override;
 
+    bool canRunInputStagesUpstream(NodeConnectionSlot* slot) override { return slot == in && cleanUp->boolValue(); }
+    void addInputPointStages(PointKernel& kernel) override;
+
     var getJSONData() override;
     void loadJSONDataItemInternal(var data) override;
 
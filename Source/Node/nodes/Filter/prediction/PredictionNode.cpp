@@ -13,9 +13,11 @@ PredictionNode::PredictionNode(var params) :
 {
 	addInOutSlot(&in, &out, CLUSTERS);
 
-	strength = addFloatParameter("Strength", "Prediction coefficient", 1, 0, 5);
-	velocityThreshold = addFloatParameter("Velocity Treshold", "Threshold at which the prediction is effective", 1, 0, 2);
-}	
+	processNoise = addFloatParameter("Process Noise", "Expected acceleration of the clusters in m/s². Higher follows sudden moves faster, lower gives smoother motion", 2, 0, 50);
+	measurementNoise = addFloatParameter("Measurement Noise", "Expected jitter of the measured centroids, in meter", .02f, .0001f, 1);
+	predictionTime = addFloatParameter("Prediction Time", "How far ahead of the last measure the clusters are predicted, in seconds. Use it to compensate the latency of the pipeline", .05f, 0, 1);
+	affectBoundingBox = addBoolParameter("Affect Bounding Box", "If checked, the bounding box is moved along with the predicted centroid", true);
+}
 
 PredictionNode::~PredictionNode()
 {
@@ -26,20 +28,147 @@ void PredictionNode::processInternal()
 {
 	Array<ClusterPtr> sources = slotClustersMap[in];
 
-	pleiades::copyClusters(sources, trackedClusters);
+	const float q = processNoise->floatValue() * processNoise->floatValue();
+	const float r = measurementNoise->floatValue() * measurementNoise->floatValue();
+	const bool affectB = affectBoundingBox->boolValue();
+	const double outputTime = Time::getMillisecondCounterHiRes() / 1000.0 + predictionTime->floatValue();
 
-	float val = strength->floatValue();
-	float thresh = velocityThreshold->floatValue();
+	std::fill(bank.seen.begin(), bank.seen.end(), 0);
 
-	for (auto& c : trackedClusters)
+	predictedClusters.clearQuick();
+	for (auto& s : sources)
 	{
-		float vel = c->velocity.length();
-		if (vel > thresh)
+		int index = idIndexMap.contains(s->id) ? idIndexMap[s->id] : -1;
+		if (index == -1)
+		{
+			index = bank.add(s->id, s->centroid, s->velocity, r, s->lastUpdateTime);
+			idIndexMap.set(s->id, index);
+		}
+		else if (s->state != Cluster::GHOST && s->lastUpdateTime > bank.lastTime[index])
 		{
-			c->centroid += c->velocity.normalised() * (vel - 1) * deltaTime * val;
+			//the tracker keeps refreshing ghosts with their frozen centroid, they are not corrected and keep moving with their last estimate
+			updateFilter(index, s->centroid, s->lastUpdateTime, q, r);
 		}
+
+		bank.seen[index] = 1;
+
+		float dt = (float)(outputTime - bank.lastTime[index]);
+		Vector3D<float> velocity(bank.velocity[0][index], bank.velocity[1][index], bank.velocity[2][index]);
+		Vector3D<float> position(bank.position[0][index], bank.position[1][index], bank.position[2][index]);
+		Vector3D<float> predicted = position + velocity * dt;
+
+		ClusterPtr c = std::make_shared<Cluster>(*s); //shares the cloud pointer, only the values are copied
+		c->velocity = velocity;
+		c->centroid = predicted;
+		if (affectB)
+		{
+			Vector3D<float> offset = predicted - s->centroid;
+			c->boundingBoxMin += offset;
+			c->boundingBoxMax += offset;
+		}
+
+		predictedClusters.add(c);
+	}
+
+	removeUnseenFilters();
+
+	sendClusters(out, predictedClusters);
+}
+
+void PredictionNode::updateFilter(int index, const Vector3D<float>& measure, double time, float q, float r)
+{
+	float dt = (float)(time - bank.lastTime[index]);
+	float dt2 = dt * dt;
+
+	//predict, white acceleration noise
+	float p00 = bank.p00[index] + dt * (2 * bank.p01[index] + dt * bank.p11[index]) + q * dt2 * dt2 / 4;
+	float p01 = bank.p01[index] + dt * bank.p11[index] + q * dt2 * dt / 2;
+	float p11 = bank.p11[index] + q * dt2;
+
+	//correct, the gain is the same on each axis
+	float s = p00 + r;
+	float k0 = p00 / s;
+	float k1 = p01 / s;
+
+	const float m[3] = { measure.x, measure.y, measure.z };
+	for (int a = 0; a < 3; a++)
+	{
+		float& pos = bank.position[a][index];
+		float& vel = bank.velocity[a][index];
+		pos += vel * dt;
+		float innovation = m[a] - pos;
+		pos += k0 * innovation;
+		vel += k1 * innovation;
+	}
+
+	bank.p00[index] = (1 - k0) * p00;
+	bank.p01[index] = (1 - k0) * p01;
+	bank.p11[index] = p11 - k1 * p01;
+	bank.lastTime[index] = time;
+}
+
+void PredictionNode::removeUnseenFilters()
+{
+	for (int i = bank.size() - 1; i >= 0; i--)
+	{
+		if (bank.seen[i]) continue;
+
+		idIndexMap.remove(bank.ids[i]);
+		int last = bank.size() - 1;
+		if (i != last) idIndexMap.set(bank.ids[last], i);
+		bank.removeAt(i);
+	}
+}
+
+void PredictionNode::onContainerParameterChangedInternal(Parameter* p)
+{
+	Node::onContainerParameterChangedInternal(p);
+	if (p == enabled && !enabled->boolValue())
+	{
+		//restart from fresh measures when enabled again
+		bank = FilterBank();
+		idIndexMap.clear();
+	}
+}
+
+int PredictionNode::FilterBank::add(int id, const Vector3D<float>& pos, const Vector3D<float>& vel, float posVariance, double time)
+{
+	ids.push_back(id);
+	const float p[3] = { pos.x, pos.y, pos.z };
+	const float v[3] = { vel.x, vel.y, vel.z };
+	for (int a = 0; a < 3; a++)
+	{
+		position[a].push_back(p[a]);
+		velocity[a].push_back(v[a]);
 	}
 
+	//the velocity given by the tracker is only a rough first guess
+	p00.push_back(posVariance);
+	p01.push_back(0);
+	p11.push_back(1);
+	lastTime.push_back(time);
+	seen.push_back(0);
 
-	sendClusters(out, trackedClusters);
-}
\ No newline at end of file
+	return size() - 1;
+}
+
+void PredictionNode::FilterBank::removeAt(int index)
+{
+	auto swapPop = [index](auto& v)
+	{
+		v[index] = v.back();
+		v.pop_back();
+	};
+
+	swapPop(ids);
+	for (int a = 0; a < 3; a++)
+	{
+		swapPop(position[a]);
+		swapPop(velocity[a]);
+	}
+	swapPop(p00);
+	swapPop(p01);
+	swapPop(p11);
+	swapPop(lastTime);
+	swapPop(seen);
+}
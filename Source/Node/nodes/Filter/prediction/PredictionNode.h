@@ -11,6 +11,8 @@
 #pragma once
 
 
+//Constant velocity Kalman filter per cluster ID, predicting centroid and bounding box at the output time.
+//Output clusters share the point cloud of their source, only the cluster values are copied.
 class PredictionNode :
     public Node
 {
@@ -21,13 +23,40 @@ public:
     NodeConnectionSlot* in;
     NodeConnectionSlot* out;
 
-    Array<ClusterPtr> trackedClusters;
-
-    FloatParameter* strength;
-    FloatParameter* velocityThreshold;
+    FloatParameter* processNoise;
+    FloatParameter* measurementNoise;
+    FloatParameter* predictionTime;
+    BoolParameter* affectBoundingBox;
+
+    //One entry per tracked ID, struct of arrays so each step runs over contiguous values.
+    //Axes are filtered independently, their covariance only depends on time and noise so it is shared
+    struct FilterBank
+    {
+        std::vector<int> ids;
+        std::vector<float> position[3];
+        std::vector<float> velocity[3];
+        std::vector<float> p00; //position variance
+        std::vector<float> p01; //position / velocity covariance
+        std::vector<float> p11; //velocity variance
+        std::vector<double> lastTime;
+        std::vector<uint8> seen;
+
+        int size() const { return (int)ids.size(); }
+        int add(int id, const Vector3D<float>& pos, const Vector3D<float>& vel, float posVariance, double time);
+        void removeAt(int index); //swaps with the last one
+    };
+
+    FilterBank bank;
+    HashMap<int, int> idIndexMap;
+    Array<ClusterPtr> predictedClusters;
 
     void processInternal() override;
 
+    void updateFilter(int index, const Vector3D<float>& measure, double time, float q, float r);
+    void removeUnseenFilters();
+
+    void onContainerParameterChangedInternal(Parameter* p) override;
+
     String getTypeString() const override { return getTypeStringStatic(); }
     static String getTypeStringStatic() { return "Prediction"; }
-};
\ No newline at end of file
+};
@@ -10,7 +10,8 @@
 
 QRCodeNode::QRCodeNode(var params) :
 	Node(getTypeString(), FILTER, params),
-	findOnNextProcess(false)
+	findOnNextProcess(false),
+	planeTransformIsDirty(true)
 {
 	angle = 0;
 
@@ -59,6 +60,7 @@ void QRCodeNode::processInternal()
 	{
 		detectQR(source, img);
 		findOnNextProcess = false;
+		planeTransformIsDirty = true;
 	}
 
 	if (!out->isEmpty())
@@ -252,28 +254,45 @@ void QRCodeNode::detectQR(CloudPtr source, Image& img)
 #endif
 }
 
-void QRCodeNode::transformAndSend(CloudPtr source)
+void QRCodeNode::transformAndSend(const CloudPtr& source)
 {
+	//the input is only modified when no other node reads it
+	bool ownsCloud = canWriteInputInPlace(inDepth, source);
+	CloudPtr cloud = source;
+
 	if (cleanUp->boolValue())
 	{
-		source->erase(std::remove_if(source->points.begin(), source->points.end(), [](PPoint p) { return p.x == 0 && p.y == 0 && p.z == 0; }), source->points.end());
+		auto isZero = [](const PPoint& p) { return p.x == 0 && p.y == 0 && p.z == 0; };
+		if (ownsCloud)
+		{
+			cloud->erase(std::remove_if(cloud->points.begin(), cloud->points.end(), isZero), cloud->points.end());
+		}
+		else
+		{
+			cloud = cleanUpPool.getCloud((int)source->size(), 1);
+			pleiades::copyPointsIf(*source, *cloud, [&isZero](const PPoint& p) { return !isZero(p); });
+			ownsCloud = true;
+		}
 	}
 
 	if (transformPlane->boolValue())
 	{
-		CloudPtr transformedCloud(new Cloud(source->width, source->height));
-
-		Eigen::Affine3f transform = Eigen::Affine3f::Identity();
-		transform.translate(planeOffset);
-		transform.rotate(reproj);
-		transform.rotate(Eigen::AngleAxisf(rotOffset->floatValue(), planeNormal));
-		transform.translate(-planeReference);
-		pcl::transformPointCloud(*source, *transformedCloud, transform);
-		sendPointCloud(out, transformedCloud);
+		if (planeTransformIsDirty)
+		{
+			Eigen::Affine3f transform = Eigen::Affine3f::Identity();
+			transform.translate(planeOffset);
+			transform.rotate(reproj);
+			transform.rotate(Eigen::AngleAxisf(rotOffset->floatValue(), planeNormal));
+			transform.translate(-planeReference);
+			planeTransform = transform;
+			planeTransformIsDirty = false;
+		}
+
+		sendPointCloud(out, transformer.transform(cloud, Eigen::Affine3f(planeTransform.matrix()), ownsCloud));
 	}
 	else
 	{
-		sendPointCloud(out, source);
+		sendPointCloud(out, cloud);
 	}
 }
 
@@ -281,6 +300,7 @@ void QRCodeNode::transformAndSend(CloudPtr source)
 void QRCodeNode::onContainerParameterChangedInternal(Parameter* p)
 {
 	Node::onContainerParameterChangedInternal(p);
+	if (p == rotOffset) planeTransformIsDirty = true;
 }
 
 void QRCodeNode::onContainerTriggerTriggered(Trigger* t)
@@ -337,5 +357,6 @@ void QRCodeNode::loadJSONDataItemInternal(var data)
 		planeNormal = Eigen::Vector3f(planeData[6], planeData[7], planeData[8]);
 		planeRotation = Eigen::Vector3f(planeData[9], planeData[10], planeData[11]);
 		reproj = Eigen::Quaternionf(planeData[12], planeData[13], planeData[14], planeData[15]);
+		planeTransformIsDirty = true;
 	}
 }
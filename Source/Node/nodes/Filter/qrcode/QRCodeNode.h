@@ -52,11 +52,16 @@ public:
 
     Eigen::Matrix4f reprojMat;
 
+    CloudTransformer transformer;
+    CloudPool cleanUpPool;
+    UnalignedAffine3f planeTransform; //only rebuilt after a detection or when the offset changes
+    bool planeTransformIsDirty;
+
     void processInternal() override;
 
     void calibCam(Image &img);
     void detectQR(CloudPtr source, Image &img);
-    void transformAndSend(CloudPtr source);
+    void transformAndSend(const CloudPtr& source);
 
     void onContainerParameterChangedInternal(Parameter* p) override;
     void onContainerTriggerTriggered(Trigger* t) override;
@@ -0,0 +1,452 @@
+/*
+  ==============================================================================
+
+	CloudRecordFile.cpp
+	Created: 18 Oct 2026 6:40:38am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+CloudRecordWriter::CloudRecordWriter() :
+	Thread("Cloud Record Writer"),
+	codec(CloudRecordFormat::RAW),
+	resolution(.001f),
+	lastFrameTime(0),
+	dropPolicy(DROP_NEW_FRAMES)
+{
+}
+
+CloudRecordWriter::~CloudRecordWriter()
+{
+	close();
+}
+
+bool CloudRecordWriter::open(const File& f, CloudRecordFormat::Codec c, float res, int queueSize, DropPolicy policy)
+{
+	close();
+
+	f.deleteFile();
+	os.reset(new FileOutputStream(f));
+	if (os->failedToOpen())
+	{
+		os.reset();
+		return false;
+	}
+
+	file = f;
+	codec = c;
+	resolution = jmax(res, .00001f);
+	frameIndices.clear();
+	lastFrameTime = 0;
+
+	dropPolicy = policy;
+	queueSize = jmax(queueSize, 1);
+	fifo.reset(new AbstractFifo(queueSize + 1)); //AbstractFifo keeps one slot free
+	pendingFrames.clearQuick();
+	pendingFrames.resize(queueSize + 1);
+	numQueued = 0;
+	numWritten = 0;
+	numDropped = 0;
+	waitCancelled = 0;
+
+	os->writeInt(CloudRecordFormat::headerMagic);
+	os->writeInt(CloudRecordFormat::version);
+	os->writeInt(codec);
+	os->writeFloat(codec == CloudRecordFormat::QUANTIZED ? resolution : 0);
+
+	startThread();
+	return true;
+}
+
+bool CloudRecordWriter::addFrame(float time, CloudPtr cloud)
+{
+	if (os == nullptr || cloud == nullptr) return false;
+
+	int start1, size1, start2, size2;
+	fifo->prepareToWrite(1, start1, size1, start2, size2);
+	while (size1 + size2 == 0)
+	{
+		if (dropPolicy == DROP_NEW_FRAMES || !isThreadRunning() || waitCancelled.get() != 0)
+		{
+			++numDropped;
+			return false;
+		}
+
+		//the writer signals after each written frame, on exit and when the wait is cancelled
+		frameWritten.wait(-1);
+		fifo->prepareToWrite(1, start1, size1, start2, size2);
+	}
+
+	PendingFrame& f = pendingFrames.getReference(size1 > 0 ? start1 : start2);
+	f.time = time;
+	f.cloud = cloud;
+	fifo->finishedWrite(1);
+	++numQueued;
+
+	//only go through the event when the writer is actually sleeping
+	if (writerIsWaiting.get() != 0) frameAdded.signal();
+	return true;
+}
+
+bool CloudRecordWriter::popFrame(PendingFrame& f)
+{
+	int start1, size1, start2, size2;
+	fifo->prepareToRead(1, start1, size1, start2, size2);
+	if (size1 + size2 == 0) return false;
+
+	PendingFrame& slot = pendingFrames.getReference(size1 > 0 ? start1 : start2);
+	f.time = slot.time;
+	f.cloud = slot.cloud;
+	slot.cloud = nullptr; //don't hold the cloud in the queue, pools can reuse it once written
+	fifo->finishedRead(1);
+	return true;
+}
+
+void CloudRecordWriter::run()
+{
+	while (true)
+	{
+		PendingFrame f;
+		if (popFrame(f))
+		{
+			writeFrame(f.time, *f.cloud);
+			++numWritten;
+			if (dropPolicy == WAIT_FOR_SPACE) frameWritten.signal();
+			continue;
+		}
+
+		//only exit once everything has been written
+		if (threadShouldExit()) break;
+
+		writerIsWaiting = 1;
+		if (fifo->getNumReady() == 0) frameAdded.wait(100); //check again after raising the flag, a frame may have been added in between
+		writerIsWaiting = 0;
+	}
+
+	cancelWait(); //nothing will be written anymore, don't let addFrame wait for it
+}
+
+void CloudRecordWriter::cancelWait()
+{
+	waitCancelled = 1;
+	frameWritten.signal();
+}
+
+void CloudRecordWriter::writeFrame(float time, const Cloud& cloud)
+{
+	CloudRecordFormat::FrameIndex f;
+	f.time = time;
+	f.position = os->getPosition();
+	frameIndices.add(f);
+
+	int numPoints = (int)cloud.size();
+
+	os->writeFloat(time);
+	os->writeInt(numPoints);
+	os->writeInt(cloud.width);
+	os->writeInt(cloud.height);
+
+	if (codec == CloudRecordFormat::QUANTIZED)
+	{
+		int decodedSize = encodeQuantized(cloud);
+		os->writeInt(4 + (int)compressedData.getDataSize());
+		os->writeInt(decodedSize);
+		os->write(compressedData.getData(), compressedData.getDataSize());
+	}
+	else
+	{
+		int payloadSize = numPoints * (int)sizeof(PPoint);
+		os->writeInt(payloadSize);
+		if (numPoints > 0) os->write(cloud.points.data(), payloadSize);
+	}
+
+	lastFrameTime = time;
+}
+
+int CloudRecordWriter::encodeQuantized(const Cloud& cloud)
+{
+	int numPoints = (int)cloud.size();
+	int maskSize = (numPoints + 7) / 8;
+
+	encodedData.ensureSize(maskSize + (size_t)numPoints * 3 * 5); //5 bytes max per varint
+	uint8* mask = (uint8*)encodedData.getData();
+	memset(mask, 0, maskSize);
+	uint8* dest = mask + maskSize;
+
+	const float invRes = 1.0f / resolution;
+	int prev[3] = { 0, 0, 0 };
+
+	for (int i = 0; i < numPoints; i++)
+	{
+		const PPoint& p = cloud.points[i];
+		if (!pcl::isFinite(p)) continue;
+
+		mask[i >> 3] |= (uint8)(1 << (i & 7));
+
+		int q[3] = { roundToInt(p.x * invRes), roundToInt(p.y * invRes), roundToInt(p.z * invRes) };
+		for (int c = 0; c < 3; c++)
+		{
+			dest = StreamProtocol::writeVarint(dest, q[c] - prev[c]);
+			prev[c] = q[c];
+		}
+	}
+
+	int decodedSize = (int)(dest - mask);
+
+	//the deltas are already small, fastest level is enough to squeeze the remaining redundancy
+	compressedData.reset();
+	{
+		GZIPCompressorOutputStream zos(compressedData, 1);
+		zos.write(mask, decodedSize);
+	}
+
+	return decodedSize;
+}
+
+void CloudRecordWriter::close()
+{
+	if (os == nullptr) return;
+
+	signalThreadShouldExit();
+	frameAdded.signal();
+	waitForThreadToExit(-1);
+
+	int64 indexPosition = os->getPosition();
+	for (auto& f : frameIndices)
+	{
+		os->writeFloat(f.time);
+		os->writeInt64(f.position);
+	}
+
+	os->writeInt64(indexPosition);
+	os->writeInt(frameIndices.size());
+	os->writeFloat(lastFrameTime);
+	os->writeInt(CloudRecordFormat::footerMagic);
+	os->flush();
+	os.reset();
+}
+
+
+
+CloudRecordReader::CloudRecordReader() :
+	data(nullptr),
+	dataSize(0),
+	codec(CloudRecordFormat::RAW),
+	resolution(0),
+	totalTime(0)
+{
+}
+
+CloudRecordReader::~CloudRecordReader()
+{
+}
+
+bool CloudRecordReader::open(const File& file)
+{
+	close();
+
+	mappedFile.reset(new MemoryMappedFile(file, MemoryMappedFile::readOnly));
+	if (mappedFile->getData() == nullptr || mappedFile->getSize() < 8)
+	{
+		close();
+		return false;
+	}
+
+	data = (const uint8*)mappedFile->getData();
+	dataSize = (int64)mappedFile->getSize();
+
+	MemoryInputStream header(data, jmin<size_t>((size_t)dataSize, CloudRecordFormat::headerSize), false);
+	if (dataSize < CloudRecordFormat::headerSize || header.readInt() != CloudRecordFormat::headerMagic)
+	{
+		codec = CloudRecordFormat::LEGACY;
+		scanFrames(8);
+		return true;
+	}
+
+	header.readInt(); //version
+	codec = (CloudRecordFormat::Codec)header.readInt();
+	resolution = header.readFloat();
+
+	if (!readIndexFromFooter()) scanFrames(CloudRecordFormat::headerSize);
+	return true;
+}
+
+void CloudRecordReader::close()
+{
+	mappedFile.reset();
+	data = nullptr;
+	dataSize = 0;
+	frameIndices.clear();
+	totalTime = 0;
+}
+
+bool CloudRecordReader::readIndexFromFooter()
+{
+	if (dataSize < CloudRecordFormat::headerSize + CloudRecordFormat::footerSize) return false;
+
+	MemoryInputStream footer(data + dataSize - CloudRecordFormat::footerSize, CloudRecordFormat::footerSize, false);
+	int64 indexPosition = footer.readInt64();
+	int numFrames = footer.readInt();
+	float time = footer.readFloat();
+	if (footer.readInt() != CloudRecordFormat::footerMagic) return false;
+
+	const int entrySize = 12;
+	if (indexPosition < CloudRecordFormat::headerSize || indexPosition + (int64)numFrames * entrySize > dataSize - CloudRecordFormat::footerSize) return false;
+
+	MemoryInputStream index(data + indexPosition, (size_t)numFrames * entrySize, false);
+	frameIndices.ensureStorageAllocated(numFrames);
+	for (int i = 0; i < numFrames; i++)
+	{
+		CloudRecordFormat::FrameIndex f;
+		f.time = index.readFloat();
+		f.position = index.readInt64();
+		frameIndices.add(f);
+	}
+
+	totalTime = time;
+	return true;
+}
+
+void CloudRecordReader::scanFrames(int64 start)
+{
+	frameIndices.clear();
+
+	int64 pos = start;
+	const int legacyHeaderSize = 8;
+	int headerBytes = codec == CloudRecordFormat::LEGACY ? legacyHeaderSize : CloudRecordFormat::frameHeaderSize;
+
+	while (pos + headerBytes <= dataSize)
+	{
+		MemoryInputStream fh(data + pos, headerBytes, false);
+		CloudRecordFormat::FrameIndex f;
+		f.time = fh.readFloat();
+		f.position = pos;
+
+		int64 payloadSize = 0;
+		if (codec == CloudRecordFormat::LEGACY) payloadSize = (int64)fh.readInt() * sizeof(PPoint);
+		else
+		{
+			fh.readInt(); //numPoints
+			fh.readInt(); //width
+			fh.readInt(); //height
+			payloadSize = fh.readInt();
+		}
+
+		if (payloadSize < 0 || pos + headerBytes + payloadSize > dataSize) break; //truncated
+
+		frameIndices.add(f);
+		totalTime = f.time;
+		pos += headerBytes + payloadSize;
+	}
+}
+
+int CloudRecordReader::getFrameIndexForTime(float t) const
+{
+	if (frameIndices.isEmpty()) return -1;
+
+	auto begin = frameIndices.begin();
+	auto it = std::upper_bound(begin, frameIndices.end(), t, [](float v, const CloudRecordFormat::FrameIndex& f) { return v < f.time; });
+	return jmax((int)(it - begin) - 1, 0);
+}
+
+bool CloudRecordReader::readFrame(int index, Cloud& cloud)
+{
+	if (!isPositiveAndBelow(index, frameIndices.size())) return false;
+
+	const CloudRecordFormat::FrameIndex& f = frameIndices.getReference(index);
+
+	//footer indices come straight from the file, check them the same way scanFrames does
+	const int legacyHeaderSize = 8;
+	int headerBytes = codec == CloudRecordFormat::LEGACY ? legacyHeaderSize : CloudRecordFormat::frameHeaderSize;
+	if (f.position < 0 || f.position + headerBytes > dataSize) return false;
+
+	int numPoints = 0;
+	int width = 0;
+	int height = 1;
+	int64 payloadSize = 0;
+	const uint8* payload = data + f.position + headerBytes;
+
+	MemoryInputStream fh(data + f.position, headerBytes, false);
+	fh.readFloat();
+	numPoints = fh.readInt();
+	if (codec == CloudRecordFormat::LEGACY)
+	{
+		width = numPoints;
+		payloadSize = (int64)numPoints * sizeof(PPoint);
+	}
+	else
+	{
+		width = fh.readInt();
+		height = fh.readInt();
+		payloadSize = fh.readInt();
+	}
+
+	if (numPoints < 0 || payloadSize < 0 || f.position + headerBytes + payloadSize > dataSize) return false;
+	if (codec != CloudRecordFormat::QUANTIZED && payloadSize != (int64)numPoints * sizeof(PPoint)) return false;
+
+	if ((int64)width * height != numPoints)
+	{
+		width = numPoints;
+		height = 1;
+	}
+
+	cloud.points.resize(numPoints);
+	cloud.width = width;
+	cloud.height = height;
+
+	if (codec == CloudRecordFormat::QUANTIZED) return decodeQuantized(payload, (int)payloadSize, numPoints, cloud);
+
+	if (numPoints > 0) memcpy(cloud.points.data(), payload, numPoints * sizeof(PPoint));
+
+	return true;
+}
+
+bool CloudRecordReader::decodeQuantized(const uint8* payload, int payloadSize, int numPoints, Cloud& cloud)
+{
+	if (payloadSize < 4) return false;
+
+	int decodedSize = (int)ByteOrder::littleEndianInt(payload);
+	int maskSize = (numPoints + 7) / 8;
+	if (decodedSize < maskSize) return false;
+
+	decodedData.ensureSize(decodedSize);
+	{
+		MemoryInputStream compressed(payload + 4, payloadSize - 4, false);
+		GZIPDecompressorInputStream zis(compressed);
+		if (zis.read(decodedData.getData(), decodedSize) != decodedSize) return false;
+	}
+
+	const uint8* mask = (const uint8*)decodedData.getData();
+	const uint8* src = mask + maskSize;
+	const uint8* end = mask + decodedSize;
+
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	int q[3] = { 0, 0, 0 };
+	bool isDense = true;
+
+	for (int i = 0; i < numPoints; i++)
+	{
+		PPoint& p = cloud.points[i];
+		if ((mask[i >> 3] & (1 << (i & 7))) == 0)
+		{
+			p.x = p.y = p.z = nan;
+			isDense = false;
+			continue;
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			int delta;
+			src = StreamProtocol::readVarint(src, end, delta);
+			q[c] += delta;
+		}
+
+		p.x = q[0] * resolution;
+		p.y = q[1] * resolution;
+		p.z = q[2] * resolution;
+	}
+
+	cloud.is_dense = isDense;
+	return true;
+}
@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+	CloudRecordFile.h
+	Created: 18 Oct 2026 6:40:38am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//Indexed .cloud format :
+//	header : int magic, int version, int codec, float resolution
+//	frames : float time, int numPoints, int width, int height, int payloadSize, payload
+//	index  : for each frame, float time and int64 position of the frame in the file
+//	footer : int64 index position, int numFrames, float totalTime, int magic
+//Files written before this format (int numFrames, float totalTime, then float time, int numPoints and raw points per frame) can still be played.
+//
+//Payload depending on the codec :
+//	RAW       : the PPoint array as is
+//	QUANTIZED : int decodedSize, then zlib compressed data of
+//	            - a bit per point, set for valid points (NaN points are not stored)
+//	            - for each valid point, x y z as integer steps of resolution, stored as the difference with the previous valid point
+//	              (the left neighbour in an organized cloud), zigzag varint encoded
+namespace CloudRecordFormat
+{
+	const int headerMagic = 0x44434c50; //PLCD
+	const int footerMagic = 0x49434c50; //PLCI
+	const int version = 1;
+	const int headerSize = 16;
+	const int frameHeaderSize = 20;
+	const int footerSize = 20;
+
+	enum Codec { RAW, LEGACY, QUANTIZED };
+
+	struct FrameIndex
+	{
+		float time = 0;
+		int64 position = 0;
+	};
+}
+
+class CloudRecordWriter :
+	public Thread
+{
+public:
+	CloudRecordWriter();
+	~CloudRecordWriter();
+
+	File file;
+	std::unique_ptr<FileOutputStream> os;
+	CloudRecordFormat::Codec codec;
+	float resolution;
+	Array<CloudRecordFormat::FrameIndex> frameIndices;
+	float lastFrameTime;
+
+	struct PendingFrame
+	{
+		float time = 0;
+		CloudPtr cloud;
+	};
+
+	enum DropPolicy { DROP_NEW_FRAMES, WAIT_FOR_SPACE };
+	DropPolicy dropPolicy;
+
+	//bounded single producer / single consumer queue, the node thread only stores a reference and never locks
+	std::unique_ptr<AbstractFifo> fifo;
+	Array<PendingFrame> pendingFrames;
+	Atomic<int> writerIsWaiting;
+	WaitableEvent frameAdded;
+	WaitableEvent frameWritten;
+	Atomic<int> waitCancelled;
+
+	Atomic<int> numQueued;
+	Atomic<int> numWritten;
+	Atomic<int> numDropped;
+
+	//only used by the writer thread
+	MemoryBlock encodedData;
+	MemoryOutputStream compressedData;
+
+	bool open(const File& file, CloudRecordFormat::Codec codec, float resolution, int queueSize, DropPolicy dropPolicy);
+	bool isOpen() const { return os != nullptr; }
+	bool addFrame(float time, CloudPtr cloud); //only keeps a reference, encoding and writing happen on the writer thread. Returns false if the frame was dropped
+	void cancelWait(); //makes a blocked addFrame drop its frame and return, so the recording can be stopped without waiting for the disk
+	void close(); //writes the pending frames, the index and the footer
+
+	int getNumFrames() const { return frameIndices.size(); }
+	File getFile() const { return file; }
+
+	void run() override;
+
+private:
+	bool popFrame(PendingFrame& f);
+	void writeFrame(float time, const Cloud& cloud);
+	int encodeQuantized(const Cloud& cloud); //returns the size of the encoded data
+};
+class CloudRecordReader
+{
+public:
+	CloudRecordReader();
+	~CloudRecordReader();
+
+	std::unique_ptr<MemoryMappedFile> mappedFile;
+	const uint8* data;
+	int64 dataSize;
+
+	CloudRecordFormat::Codec codec;
+	float resolution;
+	Array<CloudRecordFormat::FrameIndex> frameIndices;
+	float totalTime;
+
+	bool open(const File& file);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+
+	int getNumFrames() const { return frameIndices.size(); }
+	float getFrameTime(int index) const { return frameIndices[index].time; }
+	int getFrameIndexForTime(float t) const; //last frame at or before t, binary search
+
+	bool readFrame(int index, Cloud& cloud);
+
+private:
+	MemoryBlock decodedData;
+
+	bool decodeQuantized(const uint8* payload, int payloadSize, int numPoints, Cloud& cloud);
+	bool readIndexFromFooter();
+	void scanFrames(int64 start); //for legacy files and recordings that were not closed properly
+};
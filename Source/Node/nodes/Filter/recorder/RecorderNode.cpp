@@ -15,8 +15,7 @@ RecorderNode::RecorderNode(var params) :
 	lastRecordedFrameTime(0),
 	curPlayTime(0),
 	totalTime(0),
-	cloudIS(nullptr),
-	cloudOS(nullptr),
+	currentFrameIndex(-1),
 	clustersIS(nullptr),
 	clustersOS(nullptr)
 
@@ -37,6 +36,21 @@ RecorderNode::RecorderNode(var params) :
 
 	record = addTrigger("Record", "Start recording the file");
 	overwrite = addBoolParameter("Overwrite", "If checked, this will overwrite the record file is one is there. Otherwise recording will do nothing", false);
+	compression = addEnumParameter("Compression", "How points are stored. Quantized files are several times smaller, with points rounded to the resolution");
+	compression->addOption("None", CloudRecordFormat::RAW)->addOption("Quantized", CloudRecordFormat::QUANTIZED);
+	resolution = addFloatParameter("Resolution", "Precision of the stored points in meters, when compression is Quantized", .001f, .0001f, .1f);
+	queueSize = addIntParameter("Queue Size", "Number of frames that can wait to be written to disk", 32, 1, 512);
+	dropPolicy = addEnumParameter("When Queue Is Full", "What to do when the disk can't keep up and the queue is full. Waiting never loses frames but slows down the whole graph");
+	dropPolicy->addOption("Drop Frame", CloudRecordWriter::DROP_NEW_FRAMES)->addOption("Wait", CloudRecordWriter::WAIT_FOR_SPACE);
+
+	framesQueued = addIntParameter("Frames Queued", "Number of frames sent to the writer since recording started", 0, 0);
+	framesWritten = addIntParameter("Frames Written", "Number of frames written to disk since recording started", 0, 0);
+	framesDropped = addIntParameter("Frames Dropped", "Number of frames dropped because the queue was full", 0, 0);
+	for (auto& p : { framesQueued, framesWritten, framesDropped })
+	{
+		p->isSavable = false;
+		p->setControllableFeedbackOnly(true);
+	}
 	play = addTrigger("Play", "Play the file");
 	stop = addTrigger("Stop", "Stop the recording or playing depending on the current state");
 	pause = addTrigger("Pause", "Pause the recording or playing depending on the current state");
@@ -80,28 +94,23 @@ void RecorderNode::processInternal()
 
 	case RECORDING:
 
-		if (cloudOS != nullptr)
+		if (cloudWriter.isOpen() && cloudSource != nullptr)
 		{
 			double relTime = curTime - timeAtRecord;
-			LOG("Write new frame at " << relTime << ", pos : " << cloudOS->getPosition());
-			cloudOS->writeFloat(relTime);
-			cloudOS->writeInt(cloudSource->size());
-			cloudOS->write(cloudSource->points.data(), cloudSource->size() * sizeof(PPoint));
-			//DBG(" > frame time : " << relTime << ", num points : " << cloudSource->size());
-			lastRecordedFrameTime = relTime;
-			numFramesWritten++;
+			if (cloudWriter.addFrame(relTime, cloudSource)) lastRecordedFrameTime = relTime;
+			updateWriterStats();
 		}
 
 		sendPointCloud(outCloud, cloudSource);
 		break;
 
 	case PLAYING:
-		if (cloudIS != nullptr)
+		if (cloudReader.isOpen())
 		{
 			curPlayTime += curTime - lastTimeAtPlay;
 
 
-			if (readNextFrame())
+			if (readFrameAtPlayTime())
 			{
 
 				changingProgressionFromPlay = true;
@@ -125,7 +134,7 @@ void RecorderNode::processInternal()
 
 	case PAUSED:
 	{
-		if (forcePauseReadNextFrame) readNextFrame();
+		if (forcePauseReadNextFrame) readFrameAtPlayTime();
 		forcePauseReadNextFrame = false;
 		//GenericScopedLock lock(cloudLock);
 		sendPointCloud(outCloud, cloud);
@@ -134,50 +143,34 @@ void RecorderNode::processInternal()
 	}
 }
 
-bool RecorderNode::readNextFrame()
+bool RecorderNode::readFrameAtPlayTime()
 {
 	if (isClearing) return false;
-	if (cloudIS == nullptr) return false;
+	if (!cloudReader.isOpen()) return false;
 
 	float loopStart = loopRange->x * totalTime;
 	float loopEnd = loopRange->y * totalTime;
 	if (loopStart >= loopEnd) return false;
 
+	if (curPlayTime > loopEnd || curPlayTime < loopStart) curPlayTime = loopStart;
 
-	if (cloudIS->isExhausted() || curPlayTime > loopEnd)
-	{
-		curPlayTime = loopStart;// Time::getMillisecondCounter() / 1000.;
-		targetFrameTime = -1;
-		cloudIS->setPosition(8); //after num frames and total time
-	}
-
-	if (targetFrameTime > curPlayTime) return false;
-
-	//DBG("Read next frame at position " << cloudIS->getPosition());
-	targetFrameTime = cloudIS->readFloat();
-	targetFrameDataSize = cloudIS->readInt();
-
-
-	//DBG(" > frame curPlayTime : " << targetFrameTime << ", num points " << targetFrameDataSize);
-
-	if (targetFrameTime < curPlayTime)
-	{
-		cloudIS->setPosition(cloudIS->getPosition() + targetFrameDataSize * sizeof(PPoint));
-		return readNextFrame();
-	}
+	int frameIndex = cloudReader.getFrameIndexForTime(curPlayTime);
+	if (frameIndex < 0 || frameIndex == currentFrameIndex) return false;
 
+	//new cloud from the pool, the previous one may still be used down the chain
+	CloudPtr newCloud = cloudPool.getCloud(0, 0);
+	if (!cloudReader.readFrame(frameIndex, *newCloud)) return false;
 
-	{		
-		//GenericScopedLock lock(cloudLock);
-		if (cloud == nullptr) cloud.reset(new Cloud());
-		cloud->resize(targetFrameDataSize);
-		if (targetFrameDataSize > 0) cloudIS->read(cloud->points.data(), targetFrameDataSize * sizeof(PPoint));
-	}
+	cloud = newCloud;
+	currentFrameIndex = frameIndex;
 	return true;
 }
 
 void RecorderNode::setState(RecordState s)
 {
+	//with the wait policy, processInternal may be blocked in addFrame while holding the lock
+	if (s != RECORDING) cloudWriter.cancelWait();
+
 	GenericScopedLock lock(stateLock);
 	RecordState prevState = recordState->getValueDataAsEnum<RecordState>();
 	if (s == prevState) return;
@@ -187,32 +180,27 @@ void RecorderNode::setState(RecordState s)
 	case IDLE:
 		if (prevState == RECORDING)
 		{
-			if (numFramesWritten > 0)
+			if (cloudWriter.isOpen())
 			{
-				cloudOS->setPosition(0);
-				cloudOS->writeInt(numFramesWritten);
-				cloudOS->writeFloat(lastRecordedFrameTime);
-				if (cloudOS != nullptr) cloudOS->flush();
+				String fileName = cloudWriter.getFile().getFileNameWithoutExtension();
+				cloudWriter.close();
+				updateWriterStats();
 
-				LOG("Recorded " << lastRecordedFrameTime << "s in " << numFramesWritten << " frames in file " << cloudFile.getFullPathName());
+				LOG("Recorded " << lastRecordedFrameTime << "s in " << cloudWriter.getNumFrames() << " frames in file " << cloudFile.getFullPathName());
+				if (cloudWriter.numDropped.get() > 0) NLOGWARNING(niceName, cloudWriter.numDropped.get() << " frames were dropped because the disk couldn't keep up");
 
-				String fileName = cloudOS->getFile().getFileName();
 				updateFileList();
 				fileList->setValue(fileName);
-
-				cloudOS.reset();
-
 			}
 		}
-		else if (prevState == PLAYING)
+		else if (prevState == PLAYING || prevState == PAUSED)
 		{
-			cloudIS.reset();
+			cloudReader.close();
 		}
 		break;
 
 	case RECORDING:
-		if (prevState == PLAYING || prevState == PAUSED) cloudIS.reset();
-		numFramesWritten = 0;
+		if (prevState == PLAYING || prevState == PAUSED) cloudReader.close();
 
 		if (!directory->getFile().exists()) directory->getFile().createDirectory();
 		if (cloudFile.exists())
@@ -225,16 +213,14 @@ void RecorderNode::setState(RecordState s)
 			//	return;
 		}
 
-		cloudOS.reset(new FileOutputStream(cloudFile));
-		if (cloudOS->failedToOpen())
+		if (!cloudWriter.open(cloudFile, compression->getValueDataAsEnum<CloudRecordFormat::Codec>(), resolution->floatValue(), queueSize->intValue(), dropPolicy->getValueDataAsEnum<CloudRecordWriter::DropPolicy>()))
 		{
 			LOGERROR("Failed to open file " << cloudFile.getFullPathName() << " to record");
 
 			return;
 		}
-		cloudOS->writeInt(0); //will hold frames Written
-		cloudOS->writeFloat(0); //will hold totalTime
 		timeAtRecord = Time::getMillisecondCounter() / 1000.;
+		updateWriterStats();
 		break;
 
 	case PLAYING:
@@ -246,34 +232,17 @@ void RecorderNode::setState(RecordState s)
 
 		if (prevState == IDLE)
 		{
-			if (cloudOS != nullptr) cloudOS->flush();
-			cloudOS.reset();
-
-			cloudIS.reset(new FileInputStream(cloudFile));
-			if (cloudIS->failedToOpen())
+			if (!cloudReader.open(cloudFile))
 			{
-				LOGERROR("Failed to open file " << cloudFile.getFullPathName() << " to record");
+				LOGERROR("Failed to open file " << cloudFile.getFullPathName() << " to play");
 				return;
 			}
-			numFramesWritten = cloudIS->readInt();
-			totalTime = cloudIS->readFloat();
-			targetFrameTime = -1;
-
-			frameInfos.clear();
-			int frameIndex = 0;
-			while (frameIndex < numFramesWritten)
-			{
-				int posInFile = cloudIS->getPosition();
-				FrameInfo f = { cloudIS->readFloat(), posInFile, cloudIS->readInt() };
-				frameInfos.add(f);
-				cloudIS->setPosition(cloudIS->getPosition() + f.numPoints * sizeof(PPoint));
-				frameIndex++;
-			}
-
-			cloudIS->setPosition(8);
 
+			totalTime = cloudReader.totalTime;
+			curPlayTime = loopRange->x * totalTime;
+			currentFrameIndex = -1;
 
-			LOG("Loading file : " << totalTime << "s, " << numFramesWritten << " frames from " << cloudFile.getFullPathName());
+			LOG("Loading file : " << totalTime << "s, " << cloudReader.getNumFrames() << " frames from " << cloudFile.getFullPathName());
 		}
 
 
@@ -287,6 +256,13 @@ void RecorderNode::setState(RecordState s)
 	recordState->setValueWithData(s);
 }
 
+void RecorderNode::updateWriterStats()
+{
+	framesQueued->setValue(cloudWriter.numQueued.get());
+	framesWritten->setValue(cloudWriter.numWritten.get());
+	framesDropped->setValue(cloudWriter.numDropped.get());
+}
+
 void RecorderNode::updateFileList()
 {
 	setState(IDLE);
@@ -318,24 +294,6 @@ bool RecorderNode::isStartingNode()
 	return false;
 }
 
-RecorderNode::FrameInfo RecorderNode::getFrameInfoForTime(float t, bool getNextFrame)
-{
-	if (frameInfos.size() == 0) return FrameInfo();
-
-	for (int i = 0; i < frameInfos.size(); i++)
-	{
-		FrameInfo f = frameInfos[i];
-		if (f.time == t) return f;
-		if (f.time > t)
-		{
-			if (getNextFrame) return f;
-			return frameInfos[i - 1];
-		}
-	}
-
-	return frameInfos[0];
-}
-
 void RecorderNode::onContainerTriggerTriggered(Trigger* t)
 {
 	Node::onContainerTriggerTriggered(t);
@@ -358,25 +316,14 @@ void RecorderNode::onContainerParameterChangedInternal(Parameter* p)
 			RecordState s = recordState->getValueDataAsEnum<RecordState>();
 			if ((s == PLAYING || s == PAUSED) && !changingProgressionFromPlay)
 			{
-				if (cloudIS != nullptr)
+				if (cloudReader.isOpen())
 				{
 					float loopStart = loopRange->x * totalTime;
 					float loopEnd = loopRange->y * totalTime;
-					float targetPlayTime = loopStart + progression->floatValue() * (loopEnd - loopStart);
-
-					FrameInfo closestFrame = getFrameInfoForTime(targetPlayTime);
-
-					if (closestFrame.filePosition != 0)
-					{
-						cloudIS->setPosition(closestFrame.filePosition); //reset read position
-						targetFrameTime = closestFrame.time;
-						curPlayTime = targetFrameTime;
 
-						if (s == PAUSED)
-						{
-							forcePauseReadNextFrame = true;
-						}
-					}
+					//the frame is looked up by binary search when processing, nothing to read here
+					curPlayTime = loopStart + progression->floatValue() * (loopEnd - loopStart);
+					if (s == PAUSED) forcePauseReadNextFrame = true;
 				}
 			}
 		}
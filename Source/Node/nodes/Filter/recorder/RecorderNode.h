@@ -41,6 +41,14 @@ public:
 	
 	Trigger* record;
 	BoolParameter* overwrite;
+	EnumParameter* compression;
+	FloatParameter* resolution;
+	IntParameter* queueSize;
+	EnumParameter* dropPolicy;
+
+	IntParameter* framesQueued;
+	IntParameter* framesWritten;
+	IntParameter* framesDropped;
 
 	Trigger* play;
 	Trigger* pause;
@@ -55,25 +63,16 @@ public:
 	FloatParameter* progression;
 
 	File cloudFile;
-	std::unique_ptr<FileInputStream> cloudIS;
-	std::unique_ptr<FileOutputStream> cloudOS;
+	CloudRecordWriter cloudWriter;
+	CloudRecordReader cloudReader;
 
 	File clustersFile;
 	std::unique_ptr<FileInputStream> clustersIS;
 	std::unique_ptr<FileOutputStream> clustersOS;
 
 	CloudPtr cloud;
-
-	SpinLock cloudLock;
-
-	struct FrameInfo
-	{
-		float time = 0;
-		int filePosition = 0;
-		int numPoints = 0;
-	};
-
-	Array<FrameInfo> frameInfos;
+	CloudPool cloudPool;
+	int currentFrameIndex;
 
 	bool changingProgressionFromPlay;
 	bool forcePauseReadNextFrame;
@@ -84,26 +83,20 @@ public:
 	double curPlayTime;
 
 	double totalTime;
-	int numFramesWritten;
-	
-	float targetFrameTime;
-	//PPoint* targetFrameData;
-	int targetFrameDataSize;
 
-	SpinLock stateLock;
+	CriticalSection stateLock;
 
 	void processInternal() override;
-	bool readNextFrame();
+	bool readFrameAtPlayTime();
 
 	void setState(RecordState s);
+	void updateWriterStats();
 
 	void updateFileList();
 	void setupFiles();
 
 	bool isStartingNode() override;
 
-	FrameInfo getFrameInfoForTime(float t, bool getNextFrame = false);
-
 	void onContainerTriggerTriggered(Trigger* t) override;
 	void onContainerParameterChangedInternal(Parameter* p) override;
 
@@ -1,406 +1,140 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Hungarian.cpp: Implementation file for Class HungarianAlgorithm.
-// 
-// This is a C++ wrapper with slight modification of a hungarian algorithm implementation by Markus Buehren.
-// The original implementation is a few mex-functions for use in MATLAB, found here:
+//
+// Originally a C++ wrapper by Cong Ma (2016) of the Munkres implementation by Markus Buehren,
+// published under the BSD license :
 // http://www.mathworks.com/matlabcentral/fileexchange/6543-functions-for-the-rectangular-assignment-problem
-// 
-// Both this code and the orignal code are published under the BSD license.
-// by Cong Ma, 2016
-// 
+//
+// Now solved with the shortest augmenting path form of the Hungarian method (row and column potentials),
+// on a flat row-major float matrix, with a workspace kept between calls and no recursion.
+//
 
-HungarianAlgorithm::HungarianAlgorithm() : recurseStep2b(0), recurseStep3(0) {}
+HungarianAlgorithm::HungarianAlgorithm() {}
 HungarianAlgorithm::~HungarianAlgorithm() {}
 
-//********************************************************//
-// A single function wrapper for solving assignment problem.
-//********************************************************//
-double HungarianAlgorithm::Solve(Array<Array<double>>& distanceMatrix, Array<int>& assignment)
+void HungarianAlgorithm::Workspace::prepare(int numRows, int numColumns)
 {
-	int nRows = distanceMatrix.size();
-	int nCols = distanceMatrix[0].size();
-
-	double* distMatrixIn = new double[nRows * nCols];
-	int* _assignment = new int[nRows];
-	double cost = 0.0;
-
-	// Fill in the distMatrixIn. Mind the index is "i + nRows * j".
-	// Here the cost matrix of size MxN is defined as a double precision array of N*M elements. 
-	// In the solving functions matrices are seen to be saved MATLAB-internally in row-order.
-	// (i.e. the matrix [1 2; 3 4] will be stored as a vector [1 3 2 4], NOT [1 2 3 4]).
-	for (int i = 0; i < nRows; i++)
-		for (int j = 0; j < nCols; j++)
-			distMatrixIn[i + nRows * j] = distanceMatrix[i][j];
-
-
-	recurseStep2b = 0;
-	recurseStep3 = 0;
-	// call solving function
-	assignmentoptimal(_assignment, &cost, distMatrixIn, nRows, nCols);
-
-	assignment.clear();
-	for (int r = 0; r < nRows; r++)
-		assignment.add(_assignment[r]);
-
-	delete[] distMatrixIn;
-	delete[] _assignment;
-	return cost;
+	//index 0 is a virtual column / row used as the root of each augmenting path
+	u.assign(numRows + 1, 0);
+	v.assign(numColumns + 1, 0);
+	p.assign(numColumns + 1, 0);
+	way.assign(numColumns + 1, 0);
+	minv.resize(numColumns + 1);
+	usedPenalty.resize(numColumns + 1);
+	usedColumns.reserve(numColumns + 1);
 }
 
-
-//********************************************************//
-// Solve optimal solution for assignment problem using Munkres algorithm, also known as Hungarian Algorithm.
-//********************************************************//
-void HungarianAlgorithm::assignmentoptimal(int* assignment, double* cost, double* distMatrixIn, int nOfRows, int nOfColumns)
+float HungarianAlgorithm::Solve(const float* costs, int numRows, int numColumns, Array<int>& assignment)
 {
-	double* distMatrix, * distMatrixTemp, * distMatrixEnd, * columnEnd, value, minValue;
-	bool* coveredColumns, * coveredRows, * starMatrix, * newStarMatrix, * primeMatrix;
-	int nOfElements, minDim, row, col;
+	assignment.resize(numRows);
+	assignment.fill(-1);
+	if (numRows == 0 || numColumns == 0) return 0;
 
-	/* initialization */
-	*cost = 0;
-	for (row = 0; row < nOfRows; row++)
-		assignment[row] = -1;
+	float totalCost = 0;
 
-	/* generate working copy of distance Matrix */
-	/* check if all matrix elements are positive */
-	nOfElements = nOfRows * nOfColumns;
-	distMatrix = (double*)malloc(nOfElements * sizeof(double));
-	distMatrixEnd = distMatrix + nOfElements;
-
-	for (row = 0; row < nOfElements; row++)
+	if (numRows <= numColumns)
 	{
-		value = distMatrixIn[row];
-		if (value < 0)
+		solveRowsLessOrEqualColumns(costs, numRows, numColumns);
+		for (int j = 1; j <= numColumns; j++)
 		{
-			DBG("All matrix elements have to be non-negative.");
+			int row = workspace.p[j] - 1;
+			if (row < 0) continue;
+			assignment.set(row, j - 1);
+			totalCost += costs[row * numColumns + j - 1];
 		}
-
-		distMatrix[row] = value;
 	}
-
-
-	/* memory allocation */
-	coveredColumns = (bool*)calloc(nOfColumns, sizeof(bool));
-	coveredRows = (bool*)calloc(nOfRows, sizeof(bool));
-	starMatrix = (bool*)calloc(nOfElements, sizeof(bool));
-	primeMatrix = (bool*)calloc(nOfElements, sizeof(bool));
-	newStarMatrix = (bool*)calloc(nOfElements, sizeof(bool)); /* used in step4 */
-
-	/* preliminary steps */
-	if (nOfRows <= nOfColumns)
+	else
 	{
-		minDim = nOfRows;
-
-		for (row = 0; row < nOfRows; row++)
+		//more rows than columns, solve the transposed problem
+		workspace.transposed.resize((size_t)numRows * numColumns);
+		float* t = workspace.transposed.data();
+		for (int r = 0; r < numRows; r++)
+			for (int c = 0; c < numColumns; c++)
+				t[c * numRows + r] = costs[r * numColumns + c];
+
+		solveRowsLessOrEqualColumns(t, numColumns, numRows);
+		for (int j = 1; j <= numRows; j++)
 		{
-			/* find the smallest element in the row */
-			distMatrixTemp = distMatrix + row;
-			minValue = *distMatrixTemp;
-			distMatrixTemp += nOfRows;
-			while (distMatrixTemp < distMatrixEnd)
-			{
-				value = *distMatrixTemp;
-				if (value < minValue)
-					minValue = value;
-				distMatrixTemp += nOfRows;
-			}
-
-			/* subtract the smallest element from each element of the row */
-			distMatrixTemp = distMatrix + row;
-			while (distMatrixTemp < distMatrixEnd)
-			{
-				*distMatrixTemp -= minValue;
-				distMatrixTemp += nOfRows;
-			}
+			int col = workspace.p[j] - 1;
+			if (col < 0) continue;
+			assignment.set(j - 1, col);
+			totalCost += costs[(j - 1) * numColumns + col];
 		}
-
-		/* Steps 1 and 2a */
-		for (row = 0; row < nOfRows; row++)
-			for (col = 0; col < nOfColumns; col++)
-				if (fabs(distMatrix[row + nOfRows * col]) < DBL_EPSILON)
-					if (!coveredColumns[col])
-					{
-						starMatrix[row + nOfRows * col] = true;
-						coveredColumns[col] = true;
-						break;
-					}
 	}
-	else /* if(nOfRows > nOfColumns) */
-	{
-		minDim = nOfColumns;
-
-		for (col = 0; col < nOfColumns; col++)
-		{
-			/* find the smallest element in the column */
-			distMatrixTemp = distMatrix + nOfRows * col;
-			columnEnd = distMatrixTemp + nOfRows;
 
-			minValue = *distMatrixTemp++;
-			while (distMatrixTemp < columnEnd)
-			{
-				value = *distMatrixTemp++;
-				if (value < minValue)
-					minValue = value;
-			}
-
-			/* subtract the smallest element from each element of the column */
-			distMatrixTemp = distMatrix + nOfRows * col;
-			while (distMatrixTemp < columnEnd)
-				*distMatrixTemp++ -= minValue;
-		}
-
-		/* Steps 1 and 2a */
-		for (col = 0; col < nOfColumns; col++)
-			for (row = 0; row < nOfRows; row++)
-				if (fabs(distMatrix[row + nOfRows * col]) < DBL_EPSILON)
-					if (!coveredRows[row])
-					{
-						starMatrix[row + nOfRows * col] = true;
-						coveredColumns[col] = true;
-						coveredRows[row] = true;
-						break;
-					}
-		for (row = 0; row < nOfRows; row++)
-			coveredRows[row] = false;
-
-	}
-
-	/* move to step 2b */
-	step2b(assignment, distMatrix, starMatrix, newStarMatrix, primeMatrix, coveredColumns, coveredRows, nOfRows, nOfColumns, minDim);
-
-	/* compute cost and remove invalid assignments */
-	computeassignmentcost(assignment, cost, distMatrixIn, nOfRows);
-
-	/* free allocated memory */
-	free(distMatrix);
-	free(coveredColumns);
-	free(coveredRows);
-	free(starMatrix);
-	free(primeMatrix);
-	free(newStarMatrix);
-
-	return;
-}
-
-/********************************************************/
-void HungarianAlgorithm::buildassignmentvector(int* assignment, bool* starMatrix, int nOfRows, int nOfColumns)
-{
-	int row, col;
-
-	for (row = 0; row < nOfRows; row++)
-		for (col = 0; col < nOfColumns; col++)
-			if (starMatrix[row + nOfRows * col])
-			{
-#ifdef ONE_INDEXING
-				assignment[row] = col + 1; /* MATLAB-Indexing */
-#else
-				assignment[row] = col;
-#endif
-				break;
-			}
+	return totalCost;
 }
 
-/********************************************************/
-void HungarianAlgorithm::computeassignmentcost(int* assignment, double* cost, double* distMatrix, int nOfRows)
+void HungarianAlgorithm::solveRowsLessOrEqualColumns(const float* costs, int n, int m)
 {
-	int row, col;
-
-	for (row = 0; row < nOfRows; row++)
+	Workspace& w = workspace;
+	w.prepare(n, m);
+
+	const float inf = std::numeric_limits<float>::infinity();
+	float* u = w.u.data();
+	float* v = w.v.data();
+	float* minv = w.minv.data();
+	float* penalty = w.usedPenalty.data();
+	int* p = w.p.data();
+	int* way = w.way.data();
+
+	for (int i = 1; i <= n; i++)
 	{
-		col = assignment[row];
-		if (col >= 0)
-			*cost += distMatrix[row + nOfRows * col];
-	}
-}
+		//grow a shortest augmenting path from row i until it reaches a free column
+		p[0] = i;
+		int j0 = 0;
+		std::fill(minv, minv + m + 1, inf);
+		std::fill(penalty, penalty + m + 1, 0.0f);
+		w.usedColumns.clear();
+
+		do
+		{
+			penalty[j0] = inf;
+			w.usedColumns.push_back(j0);
 
-/********************************************************/
-void HungarianAlgorithm::step2a(int* assignment, double* distMatrix, bool* starMatrix, bool* newStarMatrix, bool* primeMatrix, bool* coveredColumns, bool* coveredRows, int nOfRows, int nOfColumns, int minDim)
-{
-	bool* starMatrixTemp, * columnEnd;
-	int col;
+			int i0 = p[j0];
+			const float* row = costs + (size_t)(i0 - 1) * m - 1; //row[j] for j in 1..m
+			const float ui0 = u[i0];
 
-	/* cover every column containing a starred zero */
-	for (col = 0; col < nOfColumns; col++)
-	{
-		starMatrixTemp = starMatrix + nOfRows * col;
-		columnEnd = starMatrixTemp + nOfRows;
-		while (starMatrixTemp < columnEnd) {
-			if (*starMatrixTemp++)
+			//reduced costs of the new row against the column minima, branchless so it vectorizes
+			for (int j = 1; j <= m; j++)
 			{
-				coveredColumns[col] = true;
-				break;
+				float cur = row[j] - ui0 - v[j] + penalty[j];
+				bool better = cur < minv[j];
+				minv[j] = better ? cur : minv[j];
+				way[j] = better ? j0 : way[j];
 			}
-		}
-	}
-
-	/* move to step 3 */
-	step2b(assignment, distMatrix, starMatrix, newStarMatrix, primeMatrix, coveredColumns, coveredRows, nOfRows, nOfColumns, minDim);
-}
-
-/********************************************************/
-void HungarianAlgorithm::step2b(int* assignment, double* distMatrix, bool* starMatrix, bool* newStarMatrix, bool* primeMatrix, bool* coveredColumns, bool* coveredRows, int nOfRows, int nOfColumns, int minDim)
-{
-	int col, nOfCoveredColumns;
-
-	/* count covered columns */
-	nOfCoveredColumns = 0;
-	for (col = 0; col < nOfColumns; col++)
-		if (coveredColumns[col])
-			nOfCoveredColumns++;
-
-
-	recurseStep2b++;
-	if (nOfCoveredColumns == minDim || recurseStep2b > 1000)
-	{
-		/* algorithm finished */
-		if(recurseStep2b > 1000) LOGWARNING("Recurse step 2b > 100000 ( " << recurseStep2b << "), stop hungarian to avoid stack overflow");
-		buildassignmentvector(assignment, starMatrix, nOfRows, nOfColumns);
-	}
-	else
-	{
-		/* move to step 3 */
-		step3(assignment, distMatrix, starMatrix, newStarMatrix, primeMatrix, coveredColumns, coveredRows, nOfRows, nOfColumns, minDim);
-	}
-
-}
 
-/********************************************************/
-void HungarianAlgorithm::step3(int* assignment, double* distMatrix, bool* starMatrix, bool* newStarMatrix, bool* primeMatrix, bool* coveredColumns, bool* coveredRows, int nOfRows, int nOfColumns, int minDim)
-{
-	recurseStep3++;
-	if (recurseStep3 > 100000)
-	{
-		/* algorithm finished */
-		LOGWARNING("Recurse step 3 > 100000, stop hungarian to avoid stack overflow");
-		buildassignmentvector(assignment, starMatrix, nOfRows, nOfColumns);
-		return;
-	}
-	
-	bool zerosFound;
-	int row, col, starCol;
-
-	zerosFound = true;
-	while (zerosFound)
-	{
-		zerosFound = false;
-		for (col = 0; col < nOfColumns; col++)
-			if (!coveredColumns[col])
-				for (row = 0; row < nOfRows; row++)
-					if ((!coveredRows[row]) && (fabs(distMatrix[row + nOfRows * col]) < DBL_EPSILON))
-					{
-						/* prime zero */
-						primeMatrix[row + nOfRows * col] = true;
-
-						/* find starred zero in current row */
-						for (starCol = 0; starCol < nOfColumns; starCol++)
-							if (starMatrix[row + nOfRows * starCol])
-								break;
-
-						if (starCol == nOfColumns) /* no starred zero found */
-						{
-							/* move to step 4 */
-							step4(assignment, distMatrix, starMatrix, newStarMatrix, primeMatrix, coveredColumns, coveredRows, nOfRows, nOfColumns, minDim, row, col);
-							return;
-						}
-						else
-						{
-							coveredRows[row] = true;
-							coveredColumns[starCol] = false;
-							zerosFound = true;
-							break;
-						}
-					}
-	}
-
-	/* move to step 5 */
-	step5(assignment, distMatrix, starMatrix, newStarMatrix, primeMatrix, coveredColumns, coveredRows, nOfRows, nOfColumns, minDim);
-}
-
-/********************************************************/
-void HungarianAlgorithm::step4(int* assignment, double* distMatrix, bool* starMatrix, bool* newStarMatrix, bool* primeMatrix, bool* coveredColumns, bool* coveredRows, int nOfRows, int nOfColumns, int minDim, int row, int col)
-{
-	int n, starRow, starCol, primeRow, primeCol;
-	int nOfElements = nOfRows * nOfColumns;
-
-	/* generate temporary copy of starMatrix */
-	for (n = 0; n < nOfElements; n++)
-		newStarMatrix[n] = starMatrix[n];
-
-	/* star current zero */
-	newStarMatrix[row + nOfRows * col] = true;
-
-	/* find starred zero in current column */
-	starCol = col;
-	for (starRow = 0; starRow < nOfRows; starRow++)
-		if (starMatrix[starRow + nOfRows * starCol])
-			break;
-
-	while (starRow < nOfRows)
-	{
-		/* unstar the starred zero */
-		newStarMatrix[starRow + nOfRows * starCol] = false;
-
-		/* find primed zero in current row */
-		primeRow = starRow;
-		for (primeCol = 0; primeCol < nOfColumns; primeCol++)
-			if (primeMatrix[primeRow + nOfRows * primeCol])
-				break;
-
-		/* star the primed zero */
-		newStarMatrix[primeRow + nOfRows * primeCol] = true;
-
-		/* find starred zero in current column */
-		starCol = primeCol;
-		for (starRow = 0; starRow < nOfRows; starRow++)
-			if (starMatrix[starRow + nOfRows * starCol])
-				break;
-	}
-
-	/* use temporary copy as new starMatrix */
-	/* delete all primes, uncover all rows */
-	for (n = 0; n < nOfElements; n++)
-	{
-		primeMatrix[n] = false;
-		starMatrix[n] = newStarMatrix[n];
-	}
-	for (n = 0; n < nOfRows; n++)
-		coveredRows[n] = false;
-
-	/* move to step 2a */
-	step2a(assignment, distMatrix, starMatrix, newStarMatrix, primeMatrix, coveredColumns, coveredRows, nOfRows, nOfColumns, minDim);
-}
-
-/********************************************************/
-void HungarianAlgorithm::step5(int* assignment, double* distMatrix, bool* starMatrix, bool* newStarMatrix, bool* primeMatrix, bool* coveredColumns, bool* coveredRows, int nOfRows, int nOfColumns, int minDim)
-{
-	double h, value;
-	int row, col;
-
-	/* find smallest uncovered element h */
-	h = DBL_MAX;
-	for (row = 0; row < nOfRows; row++)
-		if (!coveredRows[row])
-			for (col = 0; col < nOfColumns; col++)
-				if (!coveredColumns[col])
+			float delta = inf;
+			int j1 = 0;
+			for (int j = 1; j <= m; j++)
+			{
+				float value = minv[j] + penalty[j];
+				if (value < delta)
 				{
-					value = distMatrix[row + nOfRows * col];
-					if (value < h)
-						h = value;
+					delta = value;
+					j1 = j;
 				}
+			}
+
+			if (j1 == 0) return; //only when costs are infinite or NaN, leave the remaining rows unassigned
 
-	/* add h to each covered row */
-	for (row = 0; row < nOfRows; row++)
-		if (coveredRows[row])
-			for (col = 0; col < nOfColumns; col++)
-				distMatrix[row + nOfRows * col] += h;
+			for (auto& j : w.usedColumns)
+			{
+				u[p[j]] += delta;
+				v[j] -= delta;
+			}
+			for (int j = 1; j <= m; j++) minv[j] -= penalty[j] == 0 ? delta : 0;
 
-	/* subtract h from each uncovered column */
-	for (col = 0; col < nOfColumns; col++)
-		if (!coveredColumns[col])
-			for (row = 0; row < nOfRows; row++)
-				distMatrix[row + nOfRows * col] -= h;
+			j0 = j1;
+		} while (p[j0] != 0);
 
-	/* move to step 3 */
-	step3(assignment, distMatrix, starMatrix, newStarMatrix, primeMatrix, coveredColumns, coveredRows, nOfRows, nOfColumns, minDim);
+		//flip the path
+		do
+		{
+			int j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
 }
@@ -1,13 +1,13 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Hungarian.h: Header file for Class HungarianAlgorithm.
-// 
-// This is a C++ wrapper with slight modification of a hungarian algorithm implementation by Markus Buehren.
-// The original implementation is a few mex-functions for use in MATLAB, found here:
+//
+// Originally a C++ wrapper by Cong Ma (2016) of the Munkres implementation by Markus Buehren,
+// published under the BSD license :
 // http://www.mathworks.com/matlabcentral/fileexchange/6543-functions-for-the-rectangular-assignment-problem
-// 
-// Both this code and the orignal code are published under the BSD license.
-// by Cong Ma, 2016
-// 
+//
+// Now solved with the shortest augmenting path form of the Hungarian method (row and column potentials),
+// on a flat row-major float matrix, with a workspace kept between calls and no recursion.
+//
 
 
 #pragma once
@@ -18,17 +18,29 @@ class HungarianAlgorithm
 public:
 	HungarianAlgorithm();
 	~HungarianAlgorithm();
-	int recurseStep3;
-	int recurseStep2b;
-	double Solve(Array<Array<double>>& distMatrix, Array<int>& assignment);
+
+	//Buffers reused by every Solve call, they only grow
+	struct Workspace
+	{
+		std::vector<float> transposed;
+		std::vector<float> u; //row potentials
+		std::vector<float> v; //column potentials
+		std::vector<float> minv;
+		std::vector<float> usedPenalty; //0 for free columns, infinity for used ones, keeps the column loops branchless
+		std::vector<int> p; //row matched to each column
+		std::vector<int> way;
+		std::vector<int> usedColumns;
+
+		void prepare(int numRows, int numColumns);
+	};
+
+	//costs is row-major, numRows x numColumns, non negative.
+	//assignment[row] is set to the assigned column, or -1 for the rows left out when there are more rows than columns. Returns the total cost
+	float Solve(const float* costs, int numRows, int numColumns, Array<int>& assignment);
 
 private:
-	void assignmentoptimal(int *assignment, double *cost, double *distMatrix, int nOfRows, int nOfColumns);
-	void buildassignmentvector(int *assignment, bool *starMatrix, int nOfRows, int nOfColumns);
-	void computeassignmentcost(int *assignment, double *cost, double *distMatrix, int nOfRows);
-	void step2a(int *assignment, double *distMatrix, bool *starMatrix, bool *newStarMatrix, bool *primeMatrix, bool *coveredColumns, bool *coveredRows, int nOfRows, int nOfColumns, int minDim);
-	void step2b(int *assignment, double *distMatrix, bool *starMatrix, bool *newStarMatrix, bool *primeMatrix, bool *coveredColumns, bool *coveredRows, int nOfRows, int nOfColumns, int minDim);
-	void step3(int *assignment, double *distMatrix, bool *starMatrix, bool *newStarMatrix, bool *primeMatrix, bool *coveredColumns, bool *coveredRows, int nOfRows, int nOfColumns, int minDim);
-	void step4(int *assignment, double *distMatrix, bool *starMatrix, bool *newStarMatrix, bool *primeMatrix, bool *coveredColumns, bool *coveredRows, int nOfRows, int nOfColumns, int minDim, int row, int col);
-	void step5(int *assignment, double *distMatrix, bool *starMatrix, bool *newStarMatrix, bool *primeMatrix, bool *coveredColumns, bool *coveredRows, int nOfRows, int nOfColumns, int minDim);
-};
\ No newline at end of file
+	Workspace workspace;
+
+	//needs numRows <= numColumns, workspace.p then holds the row (1-based) assigned to each column (1-based), 0 if none
+	void solveRowsLessOrEqualColumns(const float* costs, int numRows, int numColumns);
+};
@@ -0,0 +1,232 @@
+/*
+  ==============================================================================
+
+	TrackAssignment.cpp
+	Created: 18 Oct 2026 6:50:16am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+TrackAssignment::TrackAssignment() :
+	cellSize(1),
+	numComponents(0)
+{
+}
+
+bool TrackAssignment::solve(const Array<Vector3D<float>>& trackPositions, const Array<float>& trackSearchDists, const Array<Vector3D<float>>& detectionPositions, Array<int>& assignment)
+{
+	int numTracks = trackPositions.size();
+	int numDetections = detectionPositions.size();
+
+	assignment.resize(numTracks);
+	assignment.fill(-1);
+	numComponents = 0;
+
+	if (numTracks == 0 || numDetections == 0) return true;
+
+	buildEdges(trackPositions, trackSearchDists, detectionPositions);
+	if (edges.empty()) return true;
+
+	buildComponents(numTracks, numDetections);
+
+	prices.assign(numDetections, 0);
+	owners.assign(numDetections, -1);
+
+	bool converged = true;
+	for (int c = 0; c < numComponents; c++)
+	{
+		const Edge* e = componentEdges.data() + componentStart[c];
+		int numEdges = componentStart[c + 1] - componentStart[c];
+
+		//most components are a single track with a single detection
+		if (numEdges == 1) assignment.set(e->track, e->detection);
+		else converged &= solveComponent(e, numEdges, assignment);
+	}
+
+	return converged;
+}
+
+void TrackAssignment::buildEdges(const Array<Vector3D<float>>& trackPositions, const Array<float>& trackSearchDists, const Array<Vector3D<float>>& detectionPositions)
+{
+	float maxDist = 0;
+	for (auto& d : trackSearchDists) maxDist = jmax(maxDist, d);
+	cellSize = jmax(maxDist, .01f);
+
+	sortedDetections.resize(detectionPositions.size());
+	for (int i = 0; i < detectionPositions.size(); i++)
+	{
+		const Vector3D<float>& p = detectionPositions.getReference(i);
+		sortedDetections[i] = { getCellKey(getCellCoord(p.x), getCellCoord(p.y), getCellCoord(p.z)), i };
+	}
+	std::sort(sortedDetections.begin(), sortedDetections.end());
+
+	//a detection within the search distance is at most one cell away
+	edges.clear();
+	for (int t = 0; t < trackPositions.size(); t++)
+	{
+		const Vector3D<float>& p = trackPositions.getReference(t);
+		float searchDist = trackSearchDists[t];
+		int cx = getCellCoord(p.x);
+		int cy = getCellCoord(p.y);
+		int cz = getCellCoord(p.z);
+
+		for (int x = cx - 1; x <= cx + 1; x++)
+		{
+			for (int y = cy - 1; y <= cy + 1; y++)
+			{
+				for (int z = cz - 1; z <= cz + 1; z++)
+				{
+					int64 key = getCellKey(x, y, z);
+					auto it = std::lower_bound(sortedDetections.begin(), sortedDetections.end(), std::make_pair(key, 0));
+					for (; it != sortedDetections.end() && it->first == key; it++)
+					{
+						float dist = (detectionPositions.getReference(it->second) - p).length();
+						if (dist <= searchDist) edges.push_back({ t, it->second, dist });
+					}
+				}
+			}
+		}
+	}
+}
+
+void TrackAssignment::buildComponents(int numTracks, int numDetections)
+{
+	parents.resize(numTracks + numDetections);
+	for (int i = 0; i < (int)parents.size(); i++) parents[i] = i;
+
+	for (auto& e : edges)
+	{
+		int a = findRoot(e.track);
+		int b = findRoot(numTracks + e.detection);
+		if (a != b) parents[jmax(a, b)] = jmin(a, b);
+	}
+
+	//number the components that have edges, count their edges, then group them keeping the track order
+	componentForRoot.assign(parents.size(), -1);
+	componentStart.clear();
+	for (auto& e : edges)
+	{
+		int root = findRoot(e.track);
+		if (componentForRoot[root] == -1)
+		{
+			componentForRoot[root] = (int)componentStart.size();
+			componentStart.push_back(0);
+		}
+		componentStart[componentForRoot[root]]++;
+	}
+
+	numComponents = (int)componentStart.size();
+
+	int offset = 0;
+	for (auto& s : componentStart)
+	{
+		int count = s;
+		s = offset;
+		offset += count;
+	}
+	componentStart.push_back(offset);
+
+	componentEdges.resize(edges.size());
+	std::vector<int>& fill = trackEdgeStart; //borrowed as write positions
+	fill.assign(componentStart.begin(), componentStart.end() - 1);
+	for (auto& e : edges) componentEdges[fill[componentForRoot[findRoot(e.track)]]++] = e;
+}
+
+bool TrackAssignment::solveComponent(const Edge* componentEdgesPtr, int numEdges, Array<int>& assignment)
+{
+	//edges are grouped by track, find each track's range
+	trackEdgeStart.clear();
+	for (int i = 0; i < numEdges; i++)
+	{
+		if (i == 0 || componentEdgesPtr[i].track != componentEdgesPtr[i - 1].track) trackEdgeStart.push_back(i);
+	}
+	int numBidders = (int)trackEdgeStart.size();
+	trackEdgeStart.push_back(numEdges);
+
+	//value of a match, large enough that one more match always beats any distance saving
+	float maxDist = 0;
+	for (int i = 0; i < numEdges; i++) maxDist = jmax(maxDist, componentEdgesPtr[i].dist);
+	const double matchValue = (maxDist + 1.0) * (numBidders + 1);
+	const double epsilon = .0001; //final matching is within numBidders * epsilon meters of the optimum
+
+	//warm start : each track takes its closest detection if it's still free, which is a valid auction state with zero prices
+	unassigned.clear();
+	for (int b = 0; b < numBidders; b++)
+	{
+		int best = trackEdgeStart[b];
+		for (int i = trackEdgeStart[b] + 1; i < trackEdgeStart[b + 1]; i++)
+		{
+			if (componentEdgesPtr[i].dist < componentEdgesPtr[best].dist) best = i;
+		}
+
+		int det = componentEdgesPtr[best].detection;
+		if (owners[det] == -1) owners[det] = b;
+		else unassigned.push_back(b);
+	}
+
+	int maxIterations = 1000 * numEdges;
+	for (int iteration = 0; !unassigned.empty() && iteration < maxIterations; iteration++)
+	{
+		int b = unassigned.back();
+		unassigned.pop_back();
+
+		//best and second best value, staying unmatched is worth 0
+		int bestEdge = -1;
+		double bestValue = 0;
+		double secondValue = 0;
+		for (int i = trackEdgeStart[b]; i < trackEdgeStart[b + 1]; i++)
+		{
+			const Edge& e = componentEdgesPtr[i];
+			double v = matchValue - e.dist - prices[e.detection];
+			if (v > bestValue)
+			{
+				secondValue = bestValue;
+				bestValue = v;
+				bestEdge = i;
+			}
+			else if (v > secondValue) secondValue = v;
+		}
+
+		if (bestEdge == -1) continue; //every detection is too expensive, prices only go up so this track stays unmatched
+
+		int det = componentEdgesPtr[bestEdge].detection;
+		prices[det] += bestValue - secondValue + epsilon;
+		if (owners[det] != -1) unassigned.push_back(owners[det]);
+		owners[det] = b;
+	}
+
+	for (int b = 0; b < numBidders; b++)
+	{
+		for (int i = trackEdgeStart[b]; i < trackEdgeStart[b + 1]; i++)
+		{
+			const Edge& e = componentEdgesPtr[i];
+			if (owners[e.detection] == b) assignment.set(e.track, e.detection);
+		}
+	}
+
+	//detections only belong to this component, leave them clean for the next frame
+	for (int i = 0; i < numEdges; i++)
+	{
+		prices[componentEdgesPtr[i].detection] = 0;
+		owners[componentEdgesPtr[i].detection] = -1;
+	}
+
+	return unassigned.empty();
+}
+
+int64 TrackAssignment::getCellKey(int x, int y, int z) const
+{
+	const int64 offset = 1 << 20;
+	return ((x + offset) << 42) | ((y + offset) << 21) | (z + offset);
+}
+
+int TrackAssignment::findRoot(int i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
@@ -0,0 +1,59 @@
+/*
+  ==============================================================================
+
+	TrackAssignment.h
+	Created: 18 Oct 2026 6:50:16am
+	Author:  agent
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//Matches tracked clusters with new detections, each track only considering the detections within its search distance.
+//Candidate pairs come from a uniform grid, independent groups of tracks and detections are solved separately
+//with an auction algorithm, and all buffers are kept from one frame to the next.
+//As with the dense Hungarian matching, the most pairs are matched first, then the total distance is minimized.
+class TrackAssignment
+{
+public:
+	TrackAssignment();
+
+	//assignment[track] is set to the matched detection index, or -1.
+	//Returns false if a group did not converge within the iteration limit, its tracks may then be left unmatched
+	bool solve(const Array<Vector3D<float>>& trackPositions, const Array<float>& trackSearchDists, const Array<Vector3D<float>>& detectionPositions, Array<int>& assignment);
+
+	int getNumComponents() const { return numComponents; }
+
+private:
+	struct Edge
+	{
+		int track;
+		int detection;
+		float dist;
+	};
+
+	float cellSize;
+	int numComponents;
+
+	std::vector<std::pair<int64, int>> sortedDetections; //cell key, detection index
+	std::vector<Edge> edges;
+	std::vector<Edge> componentEdges; //edges grouped by component, then by track
+	std::vector<int> componentStart;
+	std::vector<int> parents; //union-find over tracks then detections
+	std::vector<int> componentForRoot;
+
+	//auction, in double so epsilon stays above the rounding of prices that grow with the component size
+	std::vector<double> prices;
+	std::vector<int> owners;
+	std::vector<int> trackEdgeStart;
+	std::vector<int> unassigned;
+
+	void buildEdges(const Array<Vector3D<float>>& trackPositions, const Array<float>& trackSearchDists, const Array<Vector3D<float>>& detectionPositions);
+	void buildComponents(int numTracks, int numDetections);
+	bool solveComponent(const Edge* edges, int numEdges, Array<int>& assignment);
+
+	int64 getCellKey(int x, int y, int z) const;
+	int getCellCoord(float v) const { return (int)std::floor(v / cellSize); }
+	int findRoot(int i);
+};
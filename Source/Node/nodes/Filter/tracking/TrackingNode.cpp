@@ -10,7 +10,8 @@
 
 TrackingNode::TrackingNode(var params) :
 	Node(getTypeString(), FILTER, params),
-	curTrackingID(0)
+	curTrackingID(0),
+	sparseFallbackWarned(false)
 {
 	addInOutSlot(&in, &out, CLUSTERS);
 
@@ -20,6 +21,9 @@ TrackingNode::TrackingNode(var params) :
 	minAgeForGhost = addFloatParameter("Min Ghost Age", "in seconds.", .1f); // Minimum required age to become a ghost, default 1
 	maxGhostAge = addFloatParameter("Max Ghost Age", "in seconds.", 1); // Maximum time in sec a ghost can remain, default 0.5f
 
+	solver = addEnumParameter("Solver", "Sparse only compares clusters that are within search distance of each other and solves separate groups independently, it scales to large crowds. Dense Hungarian compares every pair");
+	solver->addOption("Sparse", SPARSE)->addOption("Dense Hungarian", DENSE_HUNGARIAN);
+
 	clearClusters = addTrigger("Clear clusters", "");
 }
 
@@ -38,7 +42,7 @@ void TrackingNode::processInternal()
 	int numRemoved = trackedClusters.removeIf([](ClusterPtr c) { return c->state == Cluster::WILL_LEAVE; });
 	if (numRemoved > 0) NNLOG(numRemoved << " clusters removed, remaining " << trackedClusters.size());
 
-	//Hungarian Matching
+	//Matching
 
 	Array<int> matchedClusterIndices;
 	matchedClusterIndices.resize(trackedClusters.size());
@@ -47,41 +51,116 @@ void TrackingNode::processInternal()
 	Array<int> newClusterIndices;
 	for (int i = 0; i < newClusters.size(); i++) newClusterIndices.add(i);
 
+	if (solver->getValueDataAsEnum<Solver>() == DENSE_HUNGARIAN) matchDense(newClusters, matchedClusterIndices);
+	else matchSparse(newClusters, matchedClusterIndices);
+
+	double curT = Time::getMillisecondCounterHiRes() / 1000.0;
+
+	for (size_t i = 0; i < trackedClusters.size(); i++)
+	{
+
+		ClusterPtr cluster = trackedClusters[i];
+		int matchedID = matchedClusterIndices[i];
+
+		if (matchedID != -1)
+		{
+			NNLOG("Found matching cluster for id " << cluster->id);
+			cluster->update(newClusters[matchedID]);
+			newClusterIndices.removeAllInstancesOf(matchedID);
+		}
+		else
+		{
+			NNLOG("No match for id " << cluster->id);
+			if (enableGhosting->boolValue())
+			{
+				// we did not find a match for this tracked object in the incoming detected objects, apply the ghosting algorithm 
+
+				/* #region GHOSTING */
+				cluster->velocity = Vector3D<float>();
+
+				if (cluster->state != Cluster::GHOST) {
+					// this object was not a ghost
+					if (cluster->age > minAgeForGhost->floatValue()) {
+						// if it is old enough, we turn it into a ghost
+						cluster->state = Cluster::GHOST;
+						cluster->ghostAge = 0;
+						cluster->lastUpdateTime = curT;
+					}
+					else {
+						// otherwise if it had a brief lifetime, it has good chances to be some unwanted noise
+						cluster->state = Cluster::WILL_LEAVE;
+					}
+				}
+				else {
+					// this object was already a ghost
+					if (cluster->ghostAge > maxGhostAge->floatValue()) {
+						cluster->state = Cluster::WILL_LEAVE;
+					}
+					else
+					{
+						cluster->ghostAge += curT - cluster->lastUpdateTime;
+						cluster->lastUpdateTime = curT;
+					}
+				}
+				/* #endregion */
+			}
+			else
+			{
+				cluster->state = Cluster::WILL_LEAVE;
+			}
+
+		}
+	}
+
+	// add the new objects at the end of the tracked object vector
+	for (int i = 0; i < newClusterIndices.size(); i++) {
+		ClusterPtr cluster = newClusters[newClusterIndices[i]];
+		cluster->id = curTrackingID++;
+		cluster->state = Cluster::ENTERED;
+
+		NNLOG("Add new cluster width id " << cluster->id);
+		trackedClusters.add(cluster);
+	}
+
+	//NNLOG("End of tracking, num clusters " << trackedClusters.size());
+
+	sendClusters(out, trackedClusters);
+}
+
+void TrackingNode::matchDense(Array<ClusterPtr>& newClusters, Array<int>& matchedClusterIndices)
+{
 	double curTime = Time::getMillisecondCounterHiRes() / 1000.0;
 
 	float sDist = searchDist->floatValue();
 	float ghostSDist = ghostSearchDist->floatValue();
 
-	Array<Array<double >> distanceMatrix;
-	distanceMatrix.resize(trackedClusters.size());
+	//pairs outside of search distance only complete the matrix. Kept well above any real distance but small enough for float precision
+	const float outOfRangeCost = 1000;
 
-	//Fill matrix of distances between current and new objects for the Hungarian matching
-	for (int i = 0; i < trackedClusters.size(); i++) {
+	int numTracked = trackedClusters.size();
+	int numNew = newClusters.size();
+	distanceMatrix.resize((size_t)numTracked * numNew);
 
-		Array<double> tDistMatrix;
-		tDistMatrix.resize(newClusters.size());
+	//Fill matrix of distances between current and new objects for the Hungarian matching, row-major
+	for (int i = 0; i < numTracked; i++) {
 
 		ClusterPtr cluster = trackedClusters[i];
+		float* row = distanceMatrix.data() + (size_t)i * numNew;
 
 		double timeDiff = curTime - cluster->lastUpdateTime;
 
 		Vector3D<float> predictedCentroid = cluster->centroid + cluster->velocity * timeDiff; // Dumb prediction
 
-		for (int j = 0; j < newClusters.size(); j++) {
+		float maxDist = cluster->state == Cluster::GHOST ? ghostSDist : sDist;
 
-			ClusterPtr newCluster = newClusters[j];
-			Vector3D<float> centroid = newCluster->centroid;
+		for (int j = 0; j < numNew; j++) {
 
-			float dist = (cluster->centroid - newCluster->centroid).length();
+			float dist = (cluster->centroid - newClusters[j]->centroid).length();
 
 			//float clusterSize = (cluster->boundingBoxMax - cluster->boundingBoxMin).length();
 			// Should we reintegrate size-base search ? something like  dist > 4 * clusterSize
-			if (cluster->state != Cluster::GHOST && dist > sDist) tDistMatrix.set(j, 10000+j);
-			else if (cluster->state == Cluster::GHOST && dist > ghostSDist) tDistMatrix.set(j, 10000 + j);
-			else tDistMatrix.set(j, dist);
+			row[j] = dist > maxDist ? outOfRangeCost : dist;
 		}
-
-		distanceMatrix.set(i, tDistMatrix);
 	}
 
 	// Weight distance to reduce new object, potential false-positive to "steal" ids, see doc.
@@ -124,82 +203,43 @@ void TrackingNode::processInternal()
 	//	d1++;
 	//}
 
-	hungarian.Solve(distanceMatrix, matchedClusterIndices);
-	
-
-	double curT = Time::getMillisecondCounterHiRes() / 1000.0;
+	hungarian.Solve(distanceMatrix.data(), numTracked, numNew, matchedClusterIndices);
 
-	for (size_t i = 0; i < trackedClusters.size(); i++)
+	for (int i = 0; i < matchedClusterIndices.size(); i++)
 	{
-
-		ClusterPtr cluster = trackedClusters[i];
 		int matchedID = matchedClusterIndices[i];
+		if (matchedID != -1 && distanceMatrix[(size_t)i * numNew + matchedID] >= outOfRangeCost) matchedClusterIndices.set(i, -1);
+	}
+}
 
-		if (matchedID != -1 && distanceMatrix[i][matchedID] >= 10000) matchedID = -1;
-
-		if (matchedID != -1)
-		{
-			NNLOG("Found matching cluster for id " << cluster->id);
-			cluster->update(newClusters[matchedID]);
-			newClusterIndices.removeAllInstancesOf(matchedID);
-		}
-		else
-		{
-			NNLOG("No match for id " << cluster->id);
-			if (enableGhosting->boolValue())
-			{
-				// we did not find a match for this tracked object in the incoming detected objects, apply the ghosting algorithm 
-
-				/* #region GHOSTING */
-				cluster->velocity = Vector3D<float>();
-
-				if (cluster->state != Cluster::GHOST) {
-					// this object was not a ghost
-					if (cluster->age > minAgeForGhost->floatValue()) {
-						// if it is old enough, we turn it into a ghost
-						cluster->state = Cluster::GHOST;
-						cluster->ghostAge = 0;
-						cluster->lastUpdateTime = curT;
-					}
-					else {
-						// otherwise if it had a brief lifetime, it has good chances to be some unwanted noise
-						cluster->state = Cluster::WILL_LEAVE;
-					}
-				}
-				else {
-					// this object was already a ghost
-					if (cluster->ghostAge > maxGhostAge->floatValue()) {
-						cluster->state = Cluster::WILL_LEAVE;
-					}
-					else
-					{
-						cluster->ghostAge += curT - cluster->lastUpdateTime;
-						cluster->lastUpdateTime = curT;
-					}
-				}
-				/* #endregion */
-			}
-			else
-			{
-				cluster->state = Cluster::WILL_LEAVE;
-			}
+void TrackingNode::matchSparse(Array<ClusterPtr>& newClusters, Array<int>& matchedClusterIndices)
+{
+	float sDist = searchDist->floatValue();
+	float ghostSDist = ghostSearchDist->floatValue();
 
-		}
+	trackPositions.clearQuick();
+	trackSearchDists.clearQuick();
+	for (auto& c : trackedClusters)
+	{
+		trackPositions.add(c->centroid);
+		trackSearchDists.add(c->state == Cluster::GHOST ? ghostSDist : sDist);
 	}
 
-	// add the new objects at the end of the tracked object vector
-	for (int i = 0; i < newClusterIndices.size(); i++) {
-		ClusterPtr cluster = newClusters[newClusterIndices[i]];
-		cluster->id = curTrackingID++;
-		cluster->state = Cluster::ENTERED;
+	detectionPositions.clearQuick();
+	for (auto& c : newClusters) detectionPositions.add(c->centroid);
 
-		NNLOG("Add new cluster width id " << cluster->id);
-		trackedClusters.add(cluster);
+	if (trackAssignment.solve(trackPositions, trackSearchDists, detectionPositions, matchedClusterIndices))
+	{
+		sparseFallbackWarned = false;
+		return;
 	}
 
-	//NNLOG("End of tracking, num clusters " << trackedClusters.size());
+	//should not happen, but never leave tracks unmatched because of it
+	if (!sparseFallbackWarned) NLOGWARNING(niceName, "Sparse matching did not converge, using the dense solver");
+	sparseFallbackWarned = true;
 
-	sendClusters(out, trackedClusters);
+	matchedClusterIndices.fill(-1);
+	matchDense(newClusters, matchedClusterIndices);
 }
 
 void TrackingNode::onContainerTriggerTriggered(Trigger* t)
@@ -36,9 +36,22 @@ public:
     FloatParameter* minAgeForGhost; // Minimum required age to become a ghost, default 1
     FloatParameter* maxGhostAge; // Maximum time in sec a ghost can remain, default 0.5f
 
+    enum Solver { SPARSE, DENSE_HUNGARIAN };
+    EnumParameter* solver;
+
     HungarianAlgorithm hungarian;
+    TrackAssignment trackAssignment;
+    bool sparseFallbackWarned;
+
+    //kept between frames to avoid reallocating
+    Array<Vector3D<float>> trackPositions;
+    Array<float> trackSearchDists;
+    Array<Vector3D<float>> detectionPositions;
+    std::vector<float> distanceMatrix; //dense solver, row-major tracked x new
 
     void processInternal() override;
+    void matchDense(Array<ClusterPtr>& newClusters, Array<int>& matchedClusterIndices);
+    void matchSparse(Array<ClusterPtr>& newClusters, Array<int>& matchedClusterIndices);
 
     void onContainerTriggerTriggered(Trigger* t) override;
 
@@ -9,7 +9,8 @@
 */
 
 TransformNode::TransformNode(var params) :
-	Node(getTypeString(), FILTER, params)
+	Node(getTypeString(), FILTER, params),
+	paramTransformIsDirty(true)
 {
 	addInOutSlot(&in, &out, POINTCLOUD, "In", "Transformed");
 	inTransform = addSlot("In Transform", true, TRANSFORM);
@@ -36,21 +37,25 @@ void TransformNode::processInternal()
 
 	if (!out->isEmpty())
 	{
-		CloudPtr transformedCloud(new Cloud(source->width, source->height));
-
-		Eigen::Affine3f transform = Eigen::Affine3f::Identity();
-
-		Vector3D<float> trans = translate->getVector();
-		Vector3D<float> sc = scale->getVector();
+		if (isFusedIntoNext())
+		{
+			sendPointCloud(out, source);
+			return;
+		}
 
-		Vector3D<float> rot = rotate->getVector();
-		Eigen::Quaternionf rotQuat = pleiades::euler2Quaternion(rot.z, rot.x, rot.y);
+		if (isPointChainTail())
+		{
+			sendPointCloud(out, runPointChain(source));
+			return;
+		}
 
-		
-		transform.translate(Eigen::Vector3f(trans.x, trans.y, trans.z));
-		transform.rotate(rotQuat);
+		if (paramTransformIsDirty)
+		{
+			paramTransform = pleiades::makeTransform(translate->getVector(), rotate->getVector(), scale->getVector());
+			paramTransformIsDirty = false;
+		}
 
-		transform.scale(Eigen::Vector3f(sc.x, sc.y, sc.z));
+		Eigen::Affine3f transform(paramTransform.matrix());
 
 		if (!inTransform->isEmpty())
 		{
@@ -58,7 +63,18 @@ void TransformNode::processInternal()
 			transform *= t.matrix();
 		}
 
-		pcl::transformPointCloud(*source, *transformedCloud, transform);
-		sendPointCloud(out, transformedCloud);
+		sendPointCloud(out, transformer.transform(source, transform, canWriteInputInPlace(in, source)));
 	}
+}
+
+void TransformNode::addPointStages(PointKernel& kernel)
+{
+	if (!enabled->boolValue()) return;
+	kernel.addTransform(pleiades::makeTransform(translate->getVector(), rotate->getVector(), scale->getVector()));
+}
+
+void TransformNode::onContainerParameterChangedInternal(Parameter* p)
+{
+	Node::onContainerParameterChangedInternal(p);
+	if (p == translate || p == rotate || p == scale) paramTransformIsDirty = true;
 }
\ No newline at end of file
@@ -26,8 +26,19 @@ public:
     Point3DParameter* rotate;
     Point3DParameter* scale;
 
+    CloudTransformer transformer;
+    UnalignedAffine3f paramTransform; //only rebuilt when a parameter changes
+    bool paramTransformIsDirty;
+
     void processInternal() override;
 
+    bool canFusePoints() override { return inTransform->isEmpty(); }
+    NodeConnectionSlot* getFusionInput() override { return in; }
+    NodeConnectionSlot* getFusionOutput() override { return out; }
+    void addPointStages(PointKernel& kernel) override;
+
+    void onContainerParameterChangedInternal(Parameter* p) override;
+
     String getTypeString() const override { return getTypeStringStatic(); }
     static String getTypeStringStatic() { return "Transform"; }
 };
\ No newline at end of file
@@ -8,4 +8,238 @@
   ==============================================================================
 */
 
-#include "AugmentaOutputNode.h"
+//OSC sizes, everything is padded to 4 bytes
+static const int augmentaBundleHeaderSize = 16; //"#bundle" and time tag
+static const int augmentaMaxPersonMessageSize = 4 + 20 + 20 + 15 * 4; //element size, address, type tags, args
+static const int augmentaMinPacketSize = augmentaBundleHeaderSize + augmentaMaxPersonMessageSize;
+
+AugmentaOutputNode::AugmentaOutputNode(var params) :
+	Node(getTypeString(), OUTPUT, params),
+	Thread("Augmenta Sender"),
+	frameCounter(0),
+	packetCapacity(0),
+	sendFailed(false)
+{
+	inClusters = addSlot("Clusters In", true, CLUSTERS);
+
+	remoteHost = addStringParameter("Remote Host", "IP of the machine to send the clusters to", "127.0.0.1");
+	remotePort = addIntParameter("Remote Port", "UDP port to send the clusters to", 12000, 1, 65535);
+	maxPacketSize = addIntParameter("Max Packet Size", "Maximum size of a UDP packet in bytes. Keep it under the network MTU (1500 on ethernet) to avoid fragmentation", 1400, augmentaMinPacketSize, 65000);
+	sceneMin = addPoint3DParameter("Scene Min", "Corner of the tracked area, in meters. Positions are normalized between Scene Min and Scene Max on the x and z axes");
+	sceneMin->setVector(-2, 0, -2);
+	sceneMax = addPoint3DParameter("Scene Max", "Opposite corner of the tracked area, in meters");
+	sceneMax->setVector(2, 2, 2);
+
+	startThread();
+}
+
+AugmentaOutputNode::~AugmentaOutputNode()
+{
+	signalThreadShouldExit();
+	frameAvailable.signal();
+	stopThread(1000);
+}
+
+void AugmentaOutputNode::processInternal()
+{
+	Array<ClusterPtr> clusters = slotClustersMap[inClusters];
+
+	//only copy the values here, the bundles are built and sent from the sender thread
+	ClustersFrame& f = frames.getWriteBuffer();
+	f.frameID = ++frameCounter;
+	f.host = remoteHost->stringValue();
+	f.port = remotePort->intValue();
+	f.packetSize = maxPacketSize->intValue();
+	f.sceneMin = sceneMin->getVector();
+	f.sceneMax = sceneMax->getVector();
+	f.clusters.clearQuick();
+	for (auto& c : clusters)
+	{
+		ClusterData d = { c->id, c->state, c->age, c->centroid, c->velocity, c->boundingBoxMin, c->boundingBoxMax };
+		f.clusters.add(d);
+	}
+	frames.publish();
+
+	frameAvailable.signal();
+}
+
+void AugmentaOutputNode::run()
+{
+	socket.reset(new DatagramSocket());
+
+	while (!threadShouldExit())
+	{
+		frameAvailable.wait(100);
+		if (threadShouldExit()) break;
+
+		if (!frames.fetch()) continue;
+		sendFrame(frames.getReadBuffer());
+	}
+
+	socket.reset();
+}
+
+void AugmentaOutputNode::sendFrame(const ClustersFrame& frame)
+{
+	int size = frame.packetSize;
+	if (size > packetCapacity)
+	{
+		packet.malloc(size);
+		packetCapacity = size;
+	}
+
+	char* start = packet.get();
+	char* limit = start + size;
+
+	char* d = writeBundleHeader(start);
+	d = writeSceneMessage(d, frame);
+
+	seenIDs.clearQuick();
+	for (int i = 0; i < frame.clusters.size(); i++)
+	{
+		//start a new packet when the next message may not fit
+		if (d + augmentaMaxPersonMessageSize > limit)
+		{
+			flushPacket(frame, d);
+			d = writeBundleHeader(start);
+		}
+
+		const ClusterData& c = frame.clusters.getReference(i);
+		int age = personAges.contains(c.id) ? personAges[c.id] + 1 : 0;
+		personAges.set(c.id, age);
+		seenIDs.add(c.id);
+
+		d = writePersonMessage(d, frame, c, i, age);
+	}
+
+	flushPacket(frame, d);
+
+	Array<int> leftIDs;
+	for (HashMap<int, int>::Iterator it(personAges); it.next();) if (!seenIDs.contains(it.getKey())) leftIDs.add(it.getKey());
+	for (auto& id : leftIDs) personAges.remove(id);
+}
+
+void AugmentaOutputNode::flushPacket(const ClustersFrame& frame, char* bundleEnd)
+{
+	int size = (int)(bundleEnd - packet.get());
+	if (size <= augmentaBundleHeaderSize) return;
+
+	bool failed = socket->write(frame.host, frame.port, packet.get(), size) < 0;
+	if (failed && !sendFailed) NLOGWARNING(niceName, "Could not send to " << frame.host << ":" << frame.port);
+	sendFailed = failed;
+}
+
+char* AugmentaOutputNode::writeOSCString(char* d, const char* s)
+{
+	int len = (int)strlen(s);
+	int padded = (len + 4) & ~3; //at least one null terminator
+	memcpy(d, s, len);
+	memset(d + len, 0, padded - len);
+	return d + padded;
+}
+
+char* AugmentaOutputNode::writeOSCInt(char* d, int v)
+{
+	uint32 be = ByteOrder::swapIfLittleEndian((uint32)v);
+	memcpy(d, &be, 4);
+	return d + 4;
+}
+
+char* AugmentaOutputNode::writeOSCFloat(char* d, float v)
+{
+	uint32 bits;
+	memcpy(&bits, &v, 4);
+	return writeOSCInt(d, (int)bits);
+}
+
+char* AugmentaOutputNode::writeBundleHeader(char* d)
+{
+	d = writeOSCString(d, "#bundle");
+	d = writeOSCInt(d, 0);
+	return writeOSCInt(d, 1); //time tag 1 means immediately
+}
+
+char* AugmentaOutputNode::writeSceneMessage(char* d, const ClustersFrame& frame)
+{
+	Vector3D<float> size = frame.sceneMax - frame.sceneMin;
+	float sizeX = jmax(std::abs(size.x), .001f);
+	float sizeZ = jmax(std::abs(size.z), .001f);
+
+	//sum of the normalized bounding rects, overlaps are counted twice
+	float covered = 0;
+	Vector3D<float> motion;
+	for (auto& c : frame.clusters)
+	{
+		covered += (c.boundingBoxMax.x - c.boundingBoxMin.x) / sizeX * (c.boundingBoxMax.z - c.boundingBoxMin.z) / sizeZ;
+		motion += c.velocity;
+	}
+	if (!frame.clusters.isEmpty()) motion /= (float)frame.clusters.size();
+
+	char* sizePos = d;
+	d += 4;
+
+	d = writeOSCString(d, "/au/scene");
+	d = writeOSCString(d, ",ififfiii");
+	d = writeOSCInt(d, frame.frameID);
+	d = writeOSCFloat(d, jlimit(0.0f, 1.0f, covered));
+	d = writeOSCInt(d, frame.clusters.size());
+	d = writeOSCFloat(d, motion.x / sizeX);
+	d = writeOSCFloat(d, motion.z / sizeZ);
+	d = writeOSCInt(d, roundToInt(std::abs(size.x) * 100));
+	d = writeOSCInt(d, roundToInt(std::abs(size.z) * 100));
+	d = writeOSCInt(d, roundToInt(std::abs(size.y) * 100));
+
+	writeOSCInt(sizePos, (int)(d - sizePos - 4));
+	return d;
+}
+
+char* AugmentaOutputNode::writePersonMessage(char* d, const ClustersFrame& frame, const ClusterData& c, int oid, int age)
+{
+	const Vector3D<float>& sMin = frame.sceneMin;
+	float sizeX = jmax(std::abs(frame.sceneMax.x - sMin.x), .001f);
+	float sizeZ = jmax(std::abs(frame.sceneMax.z - sMin.z), .001f);
+	float height = c.boundingBoxMax.y - c.boundingBoxMin.y;
+
+	char* sizePos = d;
+	d += 4;
+
+	const char* address = "/au/personUpdated";
+	if (c.state == Cluster::ENTERED) address = "/au/personEntered";
+	else if (c.state == Cluster::WILL_LEAVE) address = "/au/personWillLeave";
+
+	d = writeOSCString(d, address);
+	d = writeOSCString(d, ",iiiffffffffffff");
+	d = writeOSCInt(d, c.id);
+	d = writeOSCInt(d, oid);
+	d = writeOSCInt(d, age);
+	d = writeOSCFloat(d, (c.centroid.x - sMin.x) / sizeX);
+	d = writeOSCFloat(d, (c.centroid.z - sMin.z) / sizeZ);
+	d = writeOSCFloat(d, c.velocity.x / sizeX);
+	d = writeOSCFloat(d, c.velocity.z / sizeZ);
+	d = writeOSCFloat(d, height);
+	d = writeOSCFloat(d, (c.boundingBoxMin.x - sMin.x) / sizeX);
+	d = writeOSCFloat(d, (c.boundingBoxMin.z - sMin.z) / sizeZ);
+	d = writeOSCFloat(d, (c.boundingBoxMax.x - c.boundingBoxMin.x) / sizeX);
+	d = writeOSCFloat(d, (c.boundingBoxMax.z - c.boundingBoxMin.z) / sizeZ);
+	d = writeOSCFloat(d, (c.centroid.x - sMin.x) / sizeX); //highest point, the top of the box above the centroid
+	d = writeOSCFloat(d, (c.centroid.z - sMin.z) / sizeZ);
+	d = writeOSCFloat(d, height);
+
+	writeOSCInt(sizePos, (int)(d - sizePos - 4));
+	return d;
+}
+
+void AugmentaOutputNode::onContainerParameterChangedInternal(Parameter* p)
+{
+	Node::onContainerParameterChangedInternal(p);
+	if (p == enabled)
+	{
+		if (enabled->boolValue()) startThread();
+		else
+		{
+			signalThreadShouldExit();
+			frameAvailable.signal();
+			stopThread(1000);
+		}
+	}
+}
@@ -9,3 +9,82 @@
 */
 
 #pragma once
+
+//Sends clusters as OSC bundles over UDP, with the Augmenta v1 protocol :
+//	/au/scene : int currentTime (frame), float percentCovered, int numPeople, float averageMotion x y, int width, int height, int depth
+//	/au/personEntered, /au/personUpdated, /au/personWillLeave :
+//		int pid, int oid, int age (frames), float centroid x y, float velocity x y, float depth,
+//		float boundingRect x y width height, float highest x y z
+//The scene is seen from above : Augmenta x and y are the world x and z axes, normalized inside the Scene Min / Max area.
+//Velocity is normalized per second, depth and highest z are the height of the bounding box in meters, scene sizes are in centimeters.
+//Messages of a frame are packed in as few bundles as possible, each bundle fitting in one packet of at most Max Packet Size bytes.
+class AugmentaOutputNode :
+    public Node,
+    public Thread
+{
+public:
+    AugmentaOutputNode(var params = var());
+    ~AugmentaOutputNode();
+
+    NodeConnectionSlot* inClusters;
+
+    StringParameter* remoteHost;
+    IntParameter* remotePort;
+    IntParameter* maxPacketSize;
+    Point3DParameter* sceneMin;
+    Point3DParameter* sceneMax;
+
+    //what the sender needs from a cluster, copied on the graph thread
+    struct ClusterData
+    {
+        int id;
+        Cluster::State state;
+        float age;
+        Vector3D<float> centroid;
+        Vector3D<float> velocity;
+        Vector3D<float> boundingBoxMin;
+        Vector3D<float> boundingBoxMax;
+    };
+
+    //parameters are snapshotted with the frame, the sender thread never reads them
+    struct ClustersFrame
+    {
+        int frameID = 0;
+        Array<ClusterData> clusters;
+        String host;
+        int port = 0;
+        int packetSize = 0;
+        Vector3D<float> sceneMin;
+        Vector3D<float> sceneMax;
+    };
+
+    TripleBuffer<ClustersFrame> frames;
+    WaitableEvent frameAvailable;
+    int frameCounter;
+
+    //only used by the sender thread
+    std::unique_ptr<DatagramSocket> socket;
+    HeapBlock<char> packet;
+    int packetCapacity;
+    bool sendFailed; //warn once per failure streak
+    HashMap<int, int> personAges; //frames since each person entered
+    Array<int> seenIDs;
+
+    void processInternal() override;
+
+    void run() override;
+    void sendFrame(const ClustersFrame& frame);
+    void flushPacket(const ClustersFrame& frame, char* bundleEnd);
+
+    static char* writeOSCString(char* dest, const char* s);
+    static char* writeOSCInt(char* dest, int v);
+    static char* writeOSCFloat(char* dest, float v);
+    static char* writeBundleHeader(char* dest);
+    static char* writeSceneMessage(char* dest, const ClustersFrame& frame);
+    static char* writePersonMessage(char* dest, const ClustersFrame& frame, const ClusterData& c, int oid, int age);
+
+    void onContainerParameterChangedInternal(Parameter* p) override;
+
+    String getTypeString() const override { return getTypeStringStatic(); }
+    static String getTypeStringStatic() { return "Augmenta Out"; }
+};
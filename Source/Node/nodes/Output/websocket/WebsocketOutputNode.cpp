@@ -8,8 +8,13 @@
   ==============================================================================
 */
 
+//voxel size of each level of detail, in meters
+static const float websocketLODVoxelSizes[WebsocketOutputNode::numLODLevels] = { 0, .01f, .02f, .04f, .08f };
+
 WebsocketOutputNode::WebsocketOutputNode(var params) :
-	Node(getTypeString(), OUTPUT, params)
+	Node(getTypeString(), OUTPUT, params),
+	Thread("Websocket Sender"),
+	frameCounter(0)
 {
 	for (int i = 0; i < 4; i++) inClouds.add(addSlot("Cloud In " + String(i), true, POINTCLOUD));
 	for (int i = 0; i < 4; i++) inClusters.add(addSlot("ClusterIn " + String(i), true, CLUSTERS));
@@ -19,6 +24,14 @@ WebsocketOutputNode::WebsocketOutputNode(var params) :
 	doStreamClouds = addBoolParameter("Stream Clouds", "Stream Clouds", true);
 	doStreamClusters = addBoolParameter("Stream Clusters", "Stream Clusters", true);
 	streamClusterPoints = addBoolParameter("Stream Cluster Points", "Stream cloud inside clusters", true);
+	batchClusters = addBoolParameter("Batch Clusters", "If checked, all clusters of a frame are sent in a single message. The bundled web viewer only understands one message per cluster", false);
+	clusterProtocol = addEnumParameter("Cluster Protocol", "Full sends every cluster completely each frame. Delta sends keyframes, then only what changed since the last frame each client received, with quantized points. The bundled web viewer only understands Full");
+	clusterProtocol->addOption("Full", FULL)->addOption("Delta", DELTA);
+	keyframeInterval = addIntParameter("Keyframe Interval", "Number of frames between two full cluster keyframes in Delta protocol", 60, 1, 1000);
+	quantizePoints = addBoolParameter("Quantize Points", "If checked, points are sent as 16 bit integers in millimeters instead of floats, halving the bandwidth. Limited to +/- 32m, not understood by the bundled web viewer", false);
+
+	adaptiveLOD = addBoolParameter("Adaptive LOD", "If checked, clouds sent to clients that acknowledge frames are decimated with a voxel grid when their connection can't keep up", true);
+	clientTargetFPS = addIntParameter("Client Target FPS", "Frame rate the adaptive level of detail tries to keep for each client", 30, 1, 120);
 
 	sendControls = addBoolParameter("Send Controls", "If checked, this will send controls for all nodes", true);
 
@@ -33,20 +46,13 @@ WebsocketOutputNode::WebsocketOutputNode(var params) :
 
 WebsocketOutputNode::~WebsocketOutputNode()
 {
-	server->stop();
+	stopServer();
 }
 
 
 void WebsocketOutputNode::initServer()
 {
-	if (server != nullptr && server->isConnected)
-	{
-		NNLOG("Stopping Server");
-		server->removeWebSocketListener(this);
-		server->stop();
-	}
-
-	server.reset();
+	stopServer();
 
 	if (!enabled->boolValue() || isCurrentlyLoadingData) return;
 
@@ -59,6 +65,7 @@ void WebsocketOutputNode::initServer()
 	if (server->isConnected)
 	{
 		NNLOG("Server is running on port " << port->intValue());
+		startThread();
 	}
 	else
 	{
@@ -66,31 +73,81 @@ void WebsocketOutputNode::initServer()
 	}
 }
 
+void WebsocketOutputNode::stopServer()
+{
+	signalThreadShouldExit();
+	frameAvailable.signal();
+	stopThread(1000);
+
+	if (server != nullptr && server->isConnected)
+	{
+		NNLOG("Stopping Server");
+		server->removeWebSocketListener(this);
+		server->stop();
+	}
+
+	server.reset();
+
+	GenericScopedLock lock(clientsLock);
+	clients.clear();
+}
+
 void WebsocketOutputNode::processInternal()
 {
-	if (doStreamClouds->boolValue())
+	if (server != nullptr && server->getNumActiveConnections() > 0)
 	{
-		int id = 0;
-		for (auto& s : inClouds)
+		//only keep references here, serializing and sending is done by the sender thread for each client
+		std::shared_ptr<StreamFrame> frame(new StreamFrame());
+		frame->frameID = ++frameCounter;
+
+		if (doStreamClouds->boolValue())
 		{
-			id++; //always increment to have consistent ids
-			if (s->isEmpty()) continue;
-			CloudPtr c = slotCloudMap[s];
-			if (c == nullptr) continue;
-			streamCloud(c, id);
+			int id = 0;
+			for (auto& s : inClouds)
+			{
+				id++; //always increment to have consistent ids
+				if (s->isEmpty()) continue;
+				CloudPtr c = slotCloudMap[s];
+				if (c == nullptr) continue;
+
+				StreamFrame::StreamedCloud sc;
+				sc.id = id;
+				sc.levels[0] = c;
+				frame->clouds.add(sc);
+			}
 		}
-	}
 
+		if (doStreamClusters->boolValue())
+		{
+			for (auto& s : inClusters)
+			{
+				if (s->isEmpty()) continue;
+				Array<ClusterPtr> c = slotClustersMap[s];
+				if (c.isEmpty()) continue;
+
+				//clusters are updated in place by the next frames, keep a copy of what is sent. Points are shared,
+				//segmented ones are only concatenated when they are streamed
+				bool includePoints = streamClusterPoints->boolValue();
+				Array<ClusterPtr> snapshot;
+				for (auto& cluster : c)
+				{
+					ClusterPtr sc(new Cluster(cluster->id, includePoints ? cluster->getCloud() : nullptr));
+					sc->state = cluster->state;
+					sc->centroid = cluster->centroid;
+					sc->velocity = cluster->velocity;
+					sc->boundingBoxMin = cluster->boundingBoxMin;
+					sc->boundingBoxMax = cluster->boundingBoxMax;
+					snapshot.add(sc);
+				}
+				frame->clusterGroups.add(snapshot);
+			}
+		}
 
-	if (doStreamClusters->boolValue())
-	{
-		for (auto& s : inClusters)
 		{
-			if (s->isEmpty()) continue;
-			Array<ClusterPtr> c = slotClustersMap[s];
-			if (c.isEmpty()) continue;
-			streamClusters(c);
+			GenericScopedLock lock(frameLock);
+			latestFrame = frame;
 		}
+		frameAvailable.signal();
 	}
 
 	//clear after each send, avoid sending multiple time the same in one frame
@@ -98,72 +155,313 @@ void WebsocketOutputNode::processInternal()
 	slotClustersMap.clear();
 }
 
-void WebsocketOutputNode::streamCloud(CloudPtr cloud, int id)
+void WebsocketOutputNode::run()
+{
+	while (!threadShouldExit())
+	{
+		frameAvailable.wait(10); //also wakes up regularly to check for lost acks
+
+		std::shared_ptr<StreamFrame> frame;
+		{
+			GenericScopedLock lock(frameLock);
+			frame = latestFrame;
+		}
+
+		if (frame == nullptr || server == nullptr) continue;
+
+		double now = Time::getMillisecondCounterHiRes();
+		double ackTimeout = 2000;
+
+		GenericScopedLock lock(clientsLock);
+		for (auto& c : clients)
+		{
+			if (c->lastSentFrameID >= frame->frameID) continue;
+
+			if (c->waitingForAck)
+			{
+				if (now - c->sendTime < ackTimeout) continue;
+
+				//ack lost or the client is really slow, try again with less points
+				c->waitingForAck = false;
+				c->lodLevel = jmin(c->lodLevel + 1, numLODLevels - 1);
+			}
+
+			sendFrame(c, frame.get());
+		}
+	}
+}
+
+void WebsocketOutputNode::sendFrame(ClientStream* client, StreamFrame* frame)
+{
+	int level = adaptiveLOD->boolValue() ? client->lodLevel : 0;
+	int bytes = 0;
+
+	for (auto& sc : frame->clouds)
+	{
+		if (!client->isSubscribedToCloud(sc.id)) continue;
+		bytes += streamCloud(client, frame->getCloudForLevel(sc, level), sc.id);
+	}
+
+	if (client->clusters)
+	{
+		if (clusterProtocol->getValueDataAsEnum<ClusterProtocol>() == DELTA)
+		{
+			//deltas need to know all the clusters to detect the ones that left
+			Array<ClusterPtr> allClusters;
+			for (auto& g : frame->clusterGroups) allClusters.addArray(g);
+			bytes += streamClusterDeltas(client, allClusters);
+		}
+		else
+		{
+			for (auto& g : frame->clusterGroups) bytes += streamClusters(client, g);
+		}
+	}
+
+	client->lastSentFrameID = frame->frameID;
+	client->sendTime = Time::getMillisecondCounterHiRes();
+	client->sentBytes = bytes;
+	client->waitingForAck = client->usesAcks && bytes > 0;
+}
+
+void WebsocketOutputNode::updateLOD(ClientStream* client)
+{
+	double elapsed = jmax(Time::getMillisecondCounterHiRes() - client->sendTime, 1.0) / 1000.0;
+	float measured = (float)(client->sentBytes / elapsed);
+	client->throughput = client->throughput == 0 ? measured : client->throughput * .8f + measured * .2f;
+
+	if (client->throughput <= 0 || client->sentBytes == 0) return;
+
+	float frameBudget = 1.0f / clientTargetFPS->intValue();
+	float frameTime = client->sentBytes / client->throughput;
+
+	//halving the voxel size gives about 4 times more points on the surfaces we scan
+	if (frameTime > frameBudget) client->lodLevel = jmin(client->lodLevel + 1, numLODLevels - 1);
+	else if (client->lodLevel > 0 && frameTime * 4 < frameBudget * .7f) client->lodLevel--;
+}
+
+WebsocketOutputNode::ClientStream* WebsocketOutputNode::getClient(const String& id)
+{
+	for (auto& c : clients) if (c->id == id) return c;
+	return nullptr;
+}
+
+CloudPtr WebsocketOutputNode::StreamFrame::getCloudForLevel(StreamedCloud& c, int level)
+{
+	level = jlimit(0, numLODLevels - 1, level);
+	if (c.levels[level] == nullptr)
+	{
+		float ls = websocketLODVoxelSizes[level];
+
+		CloudPtr cloud(new Cloud());
+		pcl::VoxelGrid<PPoint> sor;
+		sor.setInputCloud(c.levels[0]);
+		sor.setLeafSize(ls, ls, ls);
+		sor.filter(*cloud);
+		c.levels[level] = cloud;
+	}
+
+	return c.levels[level];
+}
+
+int WebsocketOutputNode::streamCloud(ClientStream* client, CloudPtr cloud, int id)
 {
-	if (server != nullptr && server->getNumActiveConnections() == 0) return;
+	int ds = downSample->intValue();
+	bool quantized = quantizePoints->boolValue();
+	int numPoints = (int)cloud->size();
+
+	sendBuffer.ensureSize(9 + (size_t)StreamProtocol::getNumSentPoints(numPoints, ds) * StreamProtocol::getPointSize(quantized));
+	uint8* start = (uint8*)sendBuffer.getData();
 
-	NNLOG("Send cloud " << id << " with " << cloud->size() << " points");
+	uint8* d = StreamProtocol::writeByte(start, quantized ? StreamProtocol::CloudQuantizedType : StreamProtocol::CloudType);
+	d = StreamProtocol::writeInt(d, 1000 + id); //write 1000+ id to specify that it doesn't have metadata
+	if (quantized) d = StreamProtocol::writeFloat(d, StreamProtocol::quantizedStep);
+	d = StreamProtocol::writePoints(d, cloud->points.data(), numPoints, ds, quantized);
 
-	MemoryOutputStream os;
-	os.writeByte(CloudType); //cloud type
-	os.writeInt(1000 + id); //write 1000+ id to specify that it doesn't have metadata
+	int size = (int)(d - start);
+	server->sendTo((char*)start, size, client->id);
+	return size;
+}
+
+int WebsocketOutputNode::streamClusters(ClientStream* client, const Array<ClusterPtr>& clusters)
+{
+	if (!batchClusters->boolValue())
+	{
+		int bytes = 0;
+		for (int i = 0; i < clusters.size(); i++) bytes += streamCluster(client, clusters[i]);
+		return bytes;
+	}
 
+	bool includeContent = streamClusterPoints->boolValue();
+	bool quantized = quantizePoints->boolValue();
 	int ds = downSample->intValue();
-	for (int i = 0; i < cloud->size(); i += ds)
+
+	size_t size = 10;
+	for (auto& c : clusters)
 	{
-		auto p = cloud->points[i];
-		os.writeFloat(p.x);
-		os.writeFloat(p.y);
-		os.writeFloat(p.z);
+		if (c->cloud == nullptr) continue;
+		size += StreamProtocol::clusterHeaderSize + 4;
+		if (includeContent) size += (size_t)StreamProtocol::getNumSentPoints((int)c->cloud->size(), ds) * StreamProtocol::getPointSize(quantized);
 	}
-	server->send((char*)os.getData(), os.getDataSize());
+
+	sendBuffer.ensureSize(size);
+	uint8* start = (uint8*)sendBuffer.getData();
+
+	uint8* d = StreamProtocol::writeByte(start, StreamProtocol::ClusterBatchType);
+	d = StreamProtocol::writeByte(d, quantized ? 1 : 0);
+	d = StreamProtocol::writeFloat(d, StreamProtocol::quantizedStep);
+	uint8* numClustersPos = d;
+	d += 4;
+
+	int numClusters = 0;
+	for (auto& c : clusters)
+	{
+		if (c->cloud == nullptr) continue;
+		int numPoints = includeContent ? (int)c->cloud->size() : 0;
+		d = writeClusterHeader(d, c);
+		d = StreamProtocol::writeInt(d, StreamProtocol::getNumSentPoints(numPoints, ds));
+		d = StreamProtocol::writePoints(d, c->cloud->points.data(), numPoints, ds, quantized);
+		numClusters++;
+	}
+	StreamProtocol::writeInt(numClustersPos, numClusters);
+
+	int messageSize = (int)(d - start);
+	server->sendTo((char*)start, messageSize, client->id);
+	return messageSize;
 }
 
-void WebsocketOutputNode::streamClusters(Array<ClusterPtr> clusters)
+uint8* WebsocketOutputNode::writeClusterHeader(uint8* d, ClusterPtr cluster)
 {
-	if (server != nullptr && server->getNumActiveConnections() == 0) return;
-	for (int i = 0; i < clusters.size(); i++) streamCluster(clusters[i]);
+	d = StreamProtocol::writeInt(d, cluster->id);
+	d = StreamProtocol::writeInt(d, (int)cluster->state);
+
+	for (auto& v : { cluster->centroid, cluster->velocity, cluster->boundingBoxMin, cluster->boundingBoxMax })
+	{
+		d = StreamProtocol::writeFloat(d, v.x);
+		d = StreamProtocol::writeFloat(d, v.y);
+		d = StreamProtocol::writeFloat(d, v.z);
+	}
+
+	return d;
 }
 
-void WebsocketOutputNode::streamCluster(ClusterPtr cluster)
+int WebsocketOutputNode::streamCluster(ClientStream* client, ClusterPtr cluster)
 {
-	if (server != nullptr && server->getNumActiveConnections() == 0) return;
-	if (cluster->cloud == nullptr) return;
+	if (cluster->cloud == nullptr) return 0;
 
+	//one message per cluster, points are always floats and their count is deduced from the message size
+	int numPoints = streamClusterPoints->boolValue() ? (int)cluster->cloud->size() : 0;
+	int ds = downSample->intValue();
+
+	sendBuffer.ensureSize(1 + StreamProtocol::clusterHeaderSize + (size_t)StreamProtocol::getNumSentPoints(numPoints, ds) * StreamProtocol::getPointSize(false));
+	uint8* start = (uint8*)sendBuffer.getData();
+
+	uint8* d = StreamProtocol::writeByte(start, StreamProtocol::ClusterType);
+	d = writeClusterHeader(d, cluster);
+	d = StreamProtocol::writePoints(d, cluster->cloud->points.data(), numPoints, ds, false);
+
+	int size = (int)(d - start);
+	server->sendTo((char*)start, size, client->id);
+	return size;
+}
+
+int WebsocketOutputNode::streamClusterDeltas(ClientStream* client, const Array<ClusterPtr>& clusters)
+{
 	bool includeContent = streamClusterPoints->boolValue();
-	MemoryOutputStream os;
-
-	NNLOG("Send cluster with id " << cluster->id);
-
-	os.writeByte(ClusterType); //cluster type
-	os.writeInt(cluster->id);
-	os.writeInt((int)cluster->state); //cluster type
-
-	os.writeFloat(cluster->centroid.x);
-	os.writeFloat(cluster->centroid.y);
-	os.writeFloat(cluster->centroid.z);
-	os.writeFloat(cluster->velocity.x);
-	os.writeFloat(cluster->velocity.y);
-	os.writeFloat(cluster->velocity.z);
-	os.writeFloat(cluster->boundingBoxMin.x);
-	os.writeFloat(cluster->boundingBoxMin.y);
-	os.writeFloat(cluster->boundingBoxMin.z);
-	os.writeFloat(cluster->boundingBoxMax.x);
-	os.writeFloat(cluster->boundingBoxMax.y);
-	os.writeFloat(cluster->boundingBoxMax.z);
-
-	if (includeContent)
-	{
-		int ds = downSample->intValue();
-		for (int i = 0; i < cluster->cloud->size(); i += ds)
+	int ds = downSample->intValue();
+	const float step = StreamProtocol::quantizedStep;
+
+	bool keyframe = client->needsKeyframe || client->framesSinceKeyframe >= keyframeInterval->intValue();
+	if (keyframe)
+	{
+		client->sentClusters.clear();
+		client->needsKeyframe = false;
+		client->framesSinceKeyframe = 0;
+	}
+	client->framesSinceKeyframe++;
+
+	//worst case, every value as a full 5 bytes varint
+	const int maxRecordHeaderSize = 1 + 5 + 1 + 5 * (1 + StreamProtocol::ClusterState::numValues) + 5;
+	size_t size = 1 + StreamProtocol::deltaHeaderSize + (size_t)client->sentClusters.size() * 6;
+	for (auto& c : clusters)
+	{
+		if (c->cloud == nullptr) continue;
+		size += maxRecordHeaderSize;
+		if (includeContent) size += (size_t)StreamProtocol::getNumSentPoints((int)c->cloud->size(), ds) * StreamProtocol::getPointSize(true);
+	}
+
+	sendBuffer.ensureSize(size);
+	uint8* start = (uint8*)sendBuffer.getData();
+
+	uint8* d = StreamProtocol::writeByte(start, StreamProtocol::ClusterDeltaType);
+	d = StreamProtocol::writeByte(d, StreamProtocol::deltaVersion);
+	d = StreamProtocol::writeByte(d, keyframe ? 1 : 0);
+	d = StreamProtocol::writeFloat(d, step);
+	uint8* numRecordsPos = d;
+	d += 4;
+
+	int numRecords = 0;
+	Array<int> currentIDs;
+
+	for (auto& c : clusters)
+	{
+		if (c->cloud == nullptr) continue;
+
+		StreamProtocol::ClusterState s = StreamProtocol::ClusterState::fromCluster(*c, step);
+		currentIDs.add(c->id);
+
+		if (client->sentClusters.contains(c->id))
+		{
+			StreamProtocol::ClusterState previous = client->sentClusters[c->id];
+			int fields = s.getChangedFields(previous);
+
+			d = StreamProtocol::writeByte(d, StreamProtocol::RecordUpdate);
+			d = StreamProtocol::writeVarint(d, c->id);
+			d = StreamProtocol::writeByte(d, (uint8)fields);
+			if (fields & StreamProtocol::StateChanged) d = StreamProtocol::writeVarint(d, s.state);
+			for (auto f : { StreamProtocol::CentroidChanged, StreamProtocol::VelocityChanged, StreamProtocol::BoxChanged })
+			{
+				if ((fields & f) == 0) continue;
+				Range<int> r = StreamProtocol::getFieldRange(f);
+				for (int i = r.getStart(); i < r.getEnd(); i++) d = StreamProtocol::writeVarint(d, s.values[i] - previous.values[i]);
+			}
+		}
+		else
 		{
-			auto p = cluster->cloud->points[i];
-			os.writeFloat(p.x);
-			os.writeFloat(p.y);
-			os.writeFloat(p.z);
+			d = StreamProtocol::writeByte(d, StreamProtocol::RecordFull);
+			d = StreamProtocol::writeVarint(d, c->id);
+			d = StreamProtocol::writeVarint(d, s.state);
+			for (int i = 0; i < StreamProtocol::ClusterState::numValues; i++) d = StreamProtocol::writeVarint(d, s.values[i]);
 		}
+
+		int numPoints = includeContent ? (int)c->cloud->size() : 0;
+		d = StreamProtocol::writeVarint(d, StreamProtocol::getNumSentPoints(numPoints, ds));
+		d = StreamProtocol::writePoints(d, c->cloud->points.data(), numPoints, ds, true, step);
+
+		client->sentClusters.set(c->id, s);
+		numRecords++;
+	}
+
+	//clusters the client knows that are not there anymore
+	Array<int> leftIDs;
+	for (HashMap<int, StreamProtocol::ClusterState>::Iterator it(client->sentClusters); it.next();)
+	{
+		if (!currentIDs.contains(it.getKey())) leftIDs.add(it.getKey());
 	}
-	server->send((char*)os.getData(), os.getDataSize());
+
+	for (auto& id : leftIDs)
+	{
+		d = StreamProtocol::writeByte(d, StreamProtocol::RecordLeft);
+		d = StreamProtocol::writeVarint(d, id);
+		client->sentClusters.remove(id);
+		numRecords++;
+	}
+
+	if (numRecords == 0 && !keyframe) return 0;
+	StreamProtocol::writeInt(numRecordsPos, numRecords);
+
+	int messageSize = (int)(d - start);
+	server->sendTo((char*)start, messageSize, client->id);
+	return messageSize;
 }
 
 void WebsocketOutputNode::sendServerControls(var data)
@@ -178,13 +476,68 @@ void WebsocketOutputNode::sendServerControls(var data)
 
 void WebsocketOutputNode::connectionOpened(const String& id)
 {
+	{
+		GenericScopedLock lock(clientsLock);
+		ClientStream* c = new ClientStream();
+		c->id = id;
+		clients.add(c);
+	}
+
 	sendServerControls(RootNodeManager::getInstance()->getServerControls());
 }
 
+//text messages from the clients :
+//	{"type":"ack"} after each frame is handled, enables the per client flow control and level of detail
+//	{"type":"subscribe", "clouds":[1,3], "clusters":false}, a missing field means everything of that kind
+//	{"type":"keyframe"} when the client lost track of the cluster deltas
+void WebsocketOutputNode::messageReceived(const String& id, const String& message)
+{
+	var data = JSON::parse(message);
+	if (!data.isObject()) return;
+
+	String type = data.getProperty("type", "").toString();
+
+	GenericScopedLock lock(clientsLock);
+	ClientStream* c = getClient(id);
+	if (c == nullptr) return;
+
+	if (type == "ack")
+	{
+		if (c->waitingForAck) updateLOD(c);
+		c->usesAcks = true;
+		c->waitingForAck = false;
+		frameAvailable.signal();
+	}
+	else if (type == "keyframe")
+	{
+		c->needsKeyframe = true;
+	}
+	else if (type == "subscribe")
+	{
+		var cloudIDs = data.getProperty("clouds", var());
+		c->allClouds = !cloudIDs.isArray();
+		c->cloudIDs.clear();
+		if (cloudIDs.isArray()) for (int i = 0; i < cloudIDs.size(); i++) c->cloudIDs.add((int)cloudIDs[i]);
+
+		c->clusters = data.getProperty("clusters", true);
+	}
+}
+
+void WebsocketOutputNode::connectionClosed(const String& id, int status, const String& reason)
+{
+	GenericScopedLock lock(clientsLock);
+	if (ClientStream* c = getClient(id)) clients.removeObject(c);
+}
+
 void WebsocketOutputNode::onContainerParameterChangedInternal(Parameter* p)
 {
 	Node::onContainerParameterChangedInternal(p);
 	if (p == port || p == enabled) initServer();
+	else if (p == clusterProtocol)
+	{
+		GenericScopedLock lock(clientsLock);
+		for (auto& c : clients) c->needsKeyframe = true;
+	}
 }
 
 void WebsocketOutputNode::afterLoadJSONDataInternal()
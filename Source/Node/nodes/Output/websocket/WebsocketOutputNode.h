@@ -13,20 +13,14 @@
 
 class WebsocketOutputNode :
     public Node,
-    public SimpleWebSocketServer::Listener
+    public SimpleWebSocketServer::Listener,
+    public Thread
 {
 public:
     WebsocketOutputNode(var params = var());
     ~WebsocketOutputNode();
 
-    enum DataType {
-        CloudType = 0,
-        ClusterType = 1,
-        DebugBoxType = 2,
-        DebugPointType = 3,
-        DebugLineType = 4,
-        DebugPlaneType = 5
-    };
+    enum ClusterProtocol { FULL, DELTA };
 
     enum ControlType {
         Transform = 0,
@@ -42,7 +36,13 @@ public:
 	BoolParameter* doStreamClouds;
 	BoolParameter* doStreamClusters;
     BoolParameter* streamClusterPoints;
+    BoolParameter* batchClusters;
+    EnumParameter* clusterProtocol;
+    IntParameter* keyframeInterval;
+    BoolParameter* quantizePoints;
     BoolParameter* sendControls;
+    BoolParameter* adaptiveLOD;
+    IntParameter* clientTargetFPS;
 
     //BoolParameter* invertX;
     //BoolParameter* invertY;
@@ -50,18 +50,83 @@ public:
 
     std::unique_ptr<SimpleWebSocketServer> server;
 
+    //level of detail per client, level 0 sends all points, the others are voxel grids of increasing size
+    static const int numLODLevels = 5;
+
+    //what one process() received, sent to each client from the sender thread
+    struct StreamFrame
+    {
+        struct StreamedCloud
+        {
+            int id = 0;
+            CloudPtr levels[numLODLevels];
+        };
+
+        int64 frameID = 0;
+        Array<StreamedCloud> clouds;
+        Array<Array<ClusterPtr>> clusterGroups;
+
+        CloudPtr getCloudForLevel(StreamedCloud& c, int level); //decimated on first use, only called from the sender thread
+    };
+
+    struct ClientStream
+    {
+        String id;
+        int64 lastSentFrameID = -1;
+
+        //subscriptions, all by default
+        bool allClouds = true;
+        Array<int> cloudIDs;
+        bool clusters = true;
+
+        //clients that acknowledge frames get one frame in flight at a time and an adaptive level of detail
+        bool usesAcks = false;
+        bool waitingForAck = false;
+        double sendTime = 0;
+        int sentBytes = 0;
+        float throughput = 0; //bytes per second
+        int lodLevel = 0;
+
+        //delta protocol, what this client knows of each cluster
+        HashMap<int, StreamProtocol::ClusterState> sentClusters;
+        int framesSinceKeyframe = 0;
+        bool needsKeyframe = true;
+
+        bool isSubscribedToCloud(int cloudID) const { return allClouds || cloudIDs.contains(cloudID); }
+    };
+
+    SpinLock frameLock;
+    std::shared_ptr<StreamFrame> latestFrame; //only the latest frame is kept, slow clients skip the ones in between
+    int64 frameCounter;
+    WaitableEvent frameAvailable;
+
+    CriticalSection clientsLock;
+    OwnedArray<ClientStream> clients;
+
+    MemoryBlock sendBuffer; //reused for every message, the server copies the data when sending. Only used by the sender thread
+
 
     void initServer();
+    void stopServer();
 
     void processInternal() override;
 
-    void streamCloud(CloudPtr cloud, int id);
-    void streamClusters(Array<ClusterPtr> clusters);
-    void streamCluster(ClusterPtr cluster);
+    void run() override;
+    void sendFrame(ClientStream* client, StreamFrame* frame);
+    void updateLOD(ClientStream* client);
+    ClientStream* getClient(const String& id);
+
+    int streamCloud(ClientStream* client, CloudPtr cloud, int id);
+    int streamClusters(ClientStream* client, const Array<ClusterPtr>& clusters);
+    int streamCluster(ClientStream* client, ClusterPtr cluster);
+    int streamClusterDeltas(ClientStream* client, const Array<ClusterPtr>& clusters);
+    uint8* writeClusterHeader(uint8* dest, ClusterPtr cluster);
 
     void sendServerControls(var data = var());
 
     void connectionOpened(const String& id) override;
+    void messageReceived(const String& id, const String& message) override;
+    void connectionClosed(const String& id, int status, const String& reason) override;
 
     void onContainerParameterChangedInternal(Parameter* p) override;
 
@@ -17,8 +17,6 @@ AstraPlusNode::AstraPlusNode(var params) :
 	depthHeight(0),
 	ifx(0),
 	ify(0),
-	pointsData(nullptr),
-	pointsDataSize(0),
 	timeAtlastDeviceQuery(0),
 	newFrameAvailable(false)
 {
@@ -46,12 +44,6 @@ void AstraPlusNode::clearItem()
 	Node::clearItem();
 	outDepth = nullptr;
 	outColor = nullptr;
-
-	if (pointsData != nullptr)
-	{
-		free(pointsData);
-		pointsData = nullptr;
-	}
 }
 
 bool AstraPlusNode::initInternal()
@@ -212,42 +204,20 @@ void AstraPlusNode::processInternal()
 		//, 0, 3, intrinsic.cx, 0, intrinsic.fy, intrinsic.cy, 0, 0, 1);
 	}
 
-	GenericScopedLock lock(frameLock);
+	bool newDepthFrame = depthFrames.fetch();
+	PointsFrame<float>& frame = depthFrames.getReadBuffer();
 
-	if (pointsData == nullptr) return;
-	if (!newFrameAvailable && processOnlyOnNewFrame->boolValue()) return;
+	if (frame.isEmpty()) return;
+	if (!newDepthFrame && !newFrameAvailable && processOnlyOnNewFrame->boolValue()) return;
 
 
 	int ds = downSample->intValue();
-	int downW = ceil(depthWidth * 1.0f / ds);
-	int downH = ceil(depthHeight * 1.0f / ds);
-	CloudPtr cloud(new Cloud(downW, downH));
-
-	//float fx = 2 * atan(depthWidth * 1.0f / (2.0f * ifx));
-	//float fy = 2 * atan(depthHeight * 1.0f / (2.0f * ify));
-
-	{
-		for (int ty = 0; ty < depthHeight; ty += ds)
-		{
-			for (int tx = 0; tx < depthWidth; tx += ds)
-			{
-				//float relX = .5f - (tx * 1.0f / depthWidth);
-				//float relY = .5f - (ty * 1.0f / depthHeight);
-
-				int index = tx + ty * depthWidth;
-				//int dp = depthData[index * 2 + 1] << 8 | depthData[index * 2];
+	int downW = ceil(frame.width * 1.0f / ds);
+	int downH = ceil(frame.height * 1.0f / ds);
+	CloudPtr cloud = cloudPool.getCloud(downW, downH);
 
-				//float d = dp / 1000.0f;
-
-				//float x = relX * d * fx;
-				//float y = relY * d * fy;
-				//float z = d;
-
-				OBPoint p = pointsData[index];
-				cloud->at(floor(tx * 1.0f / ds), floor(ty * 1.0f / ds)) = pcl::PointXYZ(-p.x / 1000.0f, p.y / 1000.0f, p.z / 1000.0f);
-			}
-		}
-	}
+	//millimeters to meters, x flipped
+	pleiades::pointsToCloud(frame.xyz.getRawDataPointer(), frame.width, frame.height, ds, Eigen::Array4f(-.001f, .001f, .001f, 1), *cloud);
 
 	sendPointCloud(outDepth, cloud);
 	sendImage(outColor, colorImage);
@@ -287,14 +257,6 @@ void AstraPlusNode::run()
 						{
 							NLOGWARNING(niceName, "Device disconnected");
 							isInit = false;
-
-							{
-								GenericScopedLock lock(frameLock);
-								pointsDataSize = 0;
-								free(pointsData);
-								pointsData = nullptr;
-							}
-
 							pipeline.reset();
 							break;
 						}
@@ -318,19 +280,15 @@ void AstraPlusNode::run()
 
 		if (processDepth->boolValue() && frameset->depthFrame() != nullptr)
 		{
-			GenericScopedLock lock(frameLock);
 			pointCloudFilter->reset();
 			pointCloudFilter->setCreatePointFormat(OB_FORMAT_POINT);
 			if (auto frame = pointCloudFilter->process(frameset))
 			{
-				if (pointsDataSize != (int)frame->dataSize())
-				{
-					pointsDataSize = (int)frame->dataSize();
-					pointsData = (OBPoint*)malloc(pointsDataSize);
-				}
-				memcpy(pointsData, frame->data(), pointsDataSize);
-
-				newFrameAvailable = true;
+				PointsFrame<float>& f = depthFrames.getWriteBuffer();
+				f.setSize(depthWidth, depthHeight);
+				jassert((int)frame->dataSize() >= f.xyz.size() * (int)sizeof(float));
+				memcpy(f.xyz.getRawDataPointer(), frame->data(), jmin((size_t)frame->dataSize(), f.xyz.size() * sizeof(float)));
+				depthFrames.publish();
 			}
 		}
 
@@ -355,14 +313,9 @@ void AstraPlusNode::run()
 		}
 	}
 
-	{
-		GenericScopedLock lock(frameLock);
-		pointsDataSize = 0;
-		free(pointsData);
-		pointsData = nullptr;
-	}
-
-
+	//empty frame so processing stops until the device is back
+	depthFrames.getWriteBuffer().setSize(0, 0);
+	depthFrames.publish();
 
 	NNLOG("Astraplus stop reading frames");
 }
@@ -49,10 +49,8 @@ public:
     int depthWidth;
     int depthHeight;
 
-    SpinLock frameLock;
-
-    OBPoint* pointsData;
-    int pointsDataSize;
+    TripleBuffer<PointsFrame<float>> depthFrames;
+    CloudPool cloudPool;
     
     Image colorImage;
 
@@ -13,8 +13,6 @@ bool AstraProNode::astraIsInit = false;
 AstraProNode::AstraProNode(var params) :
 	Node(getTypeString(), Node::SOURCE, params),
 	Thread("Astra Pro"),
-	pointsData(nullptr),
-	pointsDataSize(0),
 	newFrameAvailable(false)
 {
 	outDepth = addSlot("Out Cloud", false, POINTCLOUD);
@@ -46,13 +44,6 @@ void AstraProNode::clearItem()
 
 	outDepth = nullptr;
 	outColor = nullptr;
-
-	if (pointsData != nullptr)
-	{
-		free(pointsData);
-		pointsData = nullptr;
-	}
-
 }
 
 bool AstraProNode::initInternal()
@@ -68,27 +59,19 @@ void AstraProNode::processInternal()
 
 	if (!enabled->boolValue()) return;
 
-	if (pointsData == nullptr) return;
-	if (!newFrameAvailable && processOnlyOnNewFrame->boolValue()) return;
+	bool newDepthFrame = depthFrames.fetch();
+	PointsFrame<float>& frame = depthFrames.getReadBuffer();
 
-	int ds = downSample->intValue();
-	int downW = ceil(depthWidth * 1.0f / ds);
-	int downH = ceil(depthHeight * 1.0f / ds);
-	CloudPtr cloud(new Cloud(downW, downH));
+	if (frame.isEmpty()) return;
+	if (!newDepthFrame && !newFrameAvailable && processOnlyOnNewFrame->boolValue()) return;
 
-	{
-		GenericScopedLock lock(frameLock);
+	int ds = downSample->intValue();
+	int downW = ceil(frame.width * 1.0f / ds);
+	int downH = ceil(frame.height * 1.0f / ds);
+	CloudPtr cloud = cloudPool.getCloud(downW, downH);
 
-		for (int ty = 0; ty < depthHeight; ty += ds)
-		{
-			for (int tx = 0; tx < depthWidth; tx += ds)
-			{
-				int index = tx + ty * depthWidth;
-				astra::Vector3f p = pointsData[index];
-				cloud->at(floor(tx * 1.0f / ds), floor(ty * 1.0f / ds)) = pcl::PointXYZ(p.x / 1000.0f, p.y / 1000.0f, p.z / 1000.0f);
-			}
-		}
-	}
+	//millimeters to meters
+	pleiades::pointsToCloud(frame.xyz.getRawDataPointer(), frame.width, frame.height, ds, Eigen::Array4f(.001f, .001f, .001f, 1), *cloud);
 
 	sendPointCloud(outDepth, cloud);
 	sendImage(outColor, colorImage);
@@ -175,16 +158,10 @@ void AstraProNode::run()
 				astra::PointFrame pointFrame = frame.get<astra::PointFrame>();
 				if (pointFrame.is_valid())
 				{
-					GenericScopedLock lock(frameLock);
-					depthWidth = pointFrame.width();
-					depthHeight = pointFrame.height();
-					int dataSize = depthWidth * depthHeight * pointFrame.bytes_per_pixel();
-					if (pointsDataSize != dataSize)
-					{
-						pointsDataSize = dataSize;
-						pointsData = (astra::Vector3f*)malloc(pointsDataSize);
-					}
-					memcpy(pointsData, pointFrame.data(), pointsDataSize);
+					PointsFrame<float>& f = depthFrames.getWriteBuffer();
+					f.setSize(pointFrame.width(), pointFrame.height());
+					memcpy(f.xyz.getRawDataPointer(), pointFrame.data(), f.xyz.size() * sizeof(float));
+					depthFrames.publish();
 				}
 			}
 
@@ -205,12 +182,9 @@ void AstraProNode::run()
 		}
 	}
 
-	{
-		GenericScopedLock lock(frameLock);
-		pointsDataSize = 0;
-		free(pointsData);
-		pointsData = nullptr;
-	}
+	//empty frame so processing stops until the device is back
+	depthFrames.getWriteBuffer().setSize(0, 0);
+	depthFrames.publish();
 
 	//astra::terminate();
 }
@@ -42,11 +42,8 @@ public:
 	BoolParameter* processOnlyOnNewFrame;
 
 
-	SpinLock frameLock;
-	int depthWidth;
-	int depthHeight;
-	astra::Vector3f* pointsData;
-	int pointsDataSize;
+	TripleBuffer<PointsFrame<float>> depthFrames;
+	CloudPool cloudPool;
 
 	Image colorImage;
 
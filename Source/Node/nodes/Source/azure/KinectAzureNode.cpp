@@ -11,9 +11,6 @@
 KinectAzureNode::KinectAzureNode(var params) :
 	Node(getTypeString(), Node::SOURCE, params),
 	Thread("KinectAzure"),
-#if USE_AZURE
-	pointCloudBuffer(nullptr),
-#endif
 	timeAtLastInit(0),
 	newFrameAvailable(false)
 {
@@ -117,34 +114,23 @@ void KinectAzureNode::processInternal()
 	//}
 
 
-	if (pointCloudBuffer == nullptr) return;
-	if (!newFrameAvailable && processOnlyOnNewFrame->boolValue()) return;
+	bool newDepthFrame = pointCloudImages.fetch();
+	k4a::image& pointCloudImage = pointCloudImages.getReadBuffer();
 
+	if (!pointCloudImage.is_valid()) return;
+	if (!newDepthFrame && !newFrameAvailable && processOnlyOnNewFrame->boolValue()) return;
+
+	depthWidth = pointCloudImage.get_width_pixels();
+	depthHeight = pointCloudImage.get_height_pixels();
 
 	int ds = downSample->intValue();
 	int downW = ceil(depthWidth * 1.0f / ds);
 	int downH = ceil(depthHeight * 1.0f / ds);
 
-	CloudPtr cloud(new Cloud(downW, downH));
-
-	{
-		GenericScopedLock lock(frameLock);
-		for (int ty = 0; ty < depthHeight; ty += ds)
-		{
-			for (int tx = 0; tx < depthWidth; tx += ds)
-			{
-				int index = (tx + ty * depthWidth) * 3;
-
-				float px = -pointCloudBuffer[index] / 1000.0f;
-				float py = -pointCloudBuffer[index + 1] / 1000.0f;
-				float pz = pointCloudBuffer[index + 2] / 1000.0f;
+	CloudPtr cloud = cloudPool.getCloud(downW, downH);
 
-				int ix = floor(tx * 1.0f / ds);
-				int iy = floor(ty * 1.0f / ds);
-				cloud->at(ix, iy) = pcl::PointXYZ(px, py, pz);
-			}
-		}
-	}
+	//millimeters to meters, x and y flipped
+	pleiades::pointsToCloud((const int16*)pointCloudImage.get_buffer(), depthWidth, depthHeight, ds, Eigen::Array4f(-.001f, -.001f, .001f, 1), *cloud);
 
 	sendPointCloud(outDepth, cloud);
 	if (colorImage.isValid()) sendImage(outColor, colorImage);
@@ -178,15 +164,17 @@ void KinectAzureNode::run()
 		if (device.get_capture(&sensor_capture, std::chrono::milliseconds(2000)))
 		{
 			depthImage = sensor_capture.get_depth_image();
+			int w = depthImage.get_width_pixels();
+			int h = depthImage.get_height_pixels();
 
+			k4a::image& pointCloudImage = pointCloudImages.getWriteBuffer();
+			if (!pointCloudImage.is_valid() || pointCloudImage.get_width_pixels() != w || pointCloudImage.get_height_pixels() != h)
 			{
-				GenericScopedLock lock(frameLock);
-				pointCloudImage = transformation.depth_image_to_point_cloud(depthImage, K4A_CALIBRATION_TYPE_DEPTH);
-				depthWidth = pointCloudImage.get_width_pixels();
-				depthHeight = pointCloudImage.get_height_pixels();
-				pointCloudBuffer = (int16_t*)pointCloudImage.get_buffer();
-				newFrameAvailable = true;
+				pointCloudImage = k4a::image::create(K4A_IMAGE_FORMAT_CUSTOM, w, h, w * 3 * (int)sizeof(int16_t));
 			}
+
+			transformation.depth_image_to_point_cloud(depthImage, K4A_CALIBRATION_TYPE_DEPTH, &pointCloudImage);
+			pointCloudImages.publish();
 		}
 		else
 		{
@@ -198,10 +186,9 @@ void KinectAzureNode::run()
 
 	if(device.is_valid()) device.close();
 
-	{
-		GenericScopedLock lock(frameLock);
-		pointCloudBuffer = nullptr;
-	}
+	//invalid image so processing stops until the device is back
+	pointCloudImages.getWriteBuffer().reset();
+	pointCloudImages.publish();
 
 	NNLOG("KinectAzure stop reading frames");
 #endif
@@ -37,8 +37,8 @@ public:
 #if USE_AZURE
 	k4a::device device;
 	k4a::transformation transformation;
-	k4a::image pointCloudImage;
-	int16* pointCloudBuffer;
+	TripleBuffer<k4a::image> pointCloudImages; //preallocated xyz images, filled by the capture thread
+	CloudPool cloudPool;
 #endif
 
 	NodeConnectionSlot* outDepth;
@@ -59,7 +59,6 @@ public:
 	int colorWidth;
 	int colorHeight;
 
-	SpinLock frameLock;
 	Image colorImage;
 
 	bool newFrameAvailable;
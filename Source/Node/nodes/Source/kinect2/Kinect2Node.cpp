@@ -18,7 +18,6 @@ Kinect2Node::Kinect2Node(var params) :
 	kinect(nullptr),
 	depthReader(nullptr),
 	colorReader(nullptr),
-	framePoints(nullptr),
 #endif
 #endif
 	newFrameAvailable(false)
@@ -61,7 +60,6 @@ void Kinect2Node::clearItem()
 	SafeRelease(coordinateMapper);
 	if (kinect) kinect->Close();
 	SafeRelease(kinect);
-	free(framePoints);
 #endif
 #endif
 
@@ -145,8 +143,6 @@ bool Kinect2Node::initInternal()
 		depthDesc->get_Width(&depthWidth);
 		depthDesc->get_Height(&depthHeight);
 
-		framePoints = (CameraSpacePoint*)malloc(depthWidth * depthHeight * sizeof(CameraSpacePoint));
-
 		IFrameDescription* colorDesc = NULL;
 		colorSource->get_FrameDescription(&colorDesc);
 		colorDesc->get_Width(&colorWidth);
@@ -195,46 +191,21 @@ void Kinect2Node::processInternal()
 		camMatrix.at<double>(1, 1) = intrinsics->FocalLengthY;
 		sendMatrix(outCamMatrix, camMatrix);
 	}
-
-	if (framePoints == nullptr) return;
 #endif
 
-	if (!newFrameAvailable && processOnlyOnNewFrame->boolValue()) return;
+	bool newDepthFrame = depthFrames.fetch();
+	PointsFrame<float>& frame = depthFrames.getReadBuffer();
 
+	if (frame.isEmpty()) return;
+	if (!newDepthFrame && !newFrameAvailable && processOnlyOnNewFrame->boolValue()) return;
 
-	int ds = downSample->intValue();
-	int downW = ceil(depthWidth * 1.0f / ds);
-	int downH = ceil(depthHeight * 1.0f / ds);
 
-	CloudPtr cloud(new Cloud(downW, downH));
+	int ds = downSample->intValue();
+	int downW = ceil(frame.width * 1.0f / ds);
+	int downH = ceil(frame.height * 1.0f / ds);
 
-	{
-		GenericScopedLock lock(frameLock);
-		for (int ty = 0; ty < depthHeight; ty += ds)
-		{
-			for (int tx = 0; tx < depthWidth; tx += ds)
-			{
-				int index = tx + ty * depthWidth;
-
-				#if USE_FREENECT
-				Vector3D<float> p = points[index];
-				#else
-				CameraSpacePoint p = framePoints[index];
-				#endif
-
-				int ix = floor(tx * 1.0f / ds);
-				int iy = floor(ty * 1.0f / ds);
-				
-				#if USE_FREENECT
-				cloud->at(ix, iy) = pcl::PointXYZ(p.x, p.y, p.z);
-				#else
-				cloud->at(ix, iy) = pcl::PointXYZ(p.X, p.Y, p.Z);
-				#endif
-				
-				//if (ty == depthHeight / 2) DBG(cloud->at(ix, iy).x);
-			}
-		}
-	}
+	CloudPtr cloud = cloudPool.getCloud(downW, downH);
+	pleiades::pointsToCloud(frame.xyz.getRawDataPointer(), frame.width, frame.height, ds, Eigen::Array4f::Ones(), *cloud);
 
 	sendPointCloud(outDepth, cloud);
 	if (colorImage.isValid()) sendImage(outColor, colorImage);
@@ -290,22 +261,22 @@ void Kinect2Node::run()
 		int ds = downSample->intValue();
 
 		{
-			GenericScopedLock lock(frameLock);
+			PointsFrame<float>& f = depthFrames.getWriteBuffer();
+			f.setSize(K2_DEPTH_WIDTH, K2_DEPTH_HEIGHT);
+			float* xyz = f.xyz.getRawDataPointer();
 			for(int tx=0;tx<K2_DEPTH_WIDTH;tx+=ds)
 			{
 				for(int ty=0;ty<K2_DEPTH_HEIGHT;ty++)
 				{
-					Vector3D<float> p;
-					registration.getPointXYZ(&undistorted, ty,tx, p.x, p.y, p.z);
-					points[ty*K2_DEPTH_WIDTH+tx] = p;
+					float* p = xyz + (ty*K2_DEPTH_WIDTH+tx) * 3;
+					registration.getPointXYZ(&undistorted, ty,tx, p[0], p[1], p[2]);
 				}
 			}
 
+			depthFrames.publish();
 		}
 
 		listener.release(frames);
-
-		newFrameAvailable = true;
 #else
 		if (!depthReader)
 		{
@@ -324,11 +295,12 @@ void Kinect2Node::run()
 			depthFrame->AccessUnderlyingBuffer(&sz, &depthFrameData);
 
 			{
-				GenericScopedLock lock(frameLock);
+				PointsFrame<float>& f = depthFrames.getWriteBuffer();
+				f.setSize(depthWidth, depthHeight);
 				coordinateMapper->MapDepthFrameToCameraSpace(
 					depthWidth * depthHeight, depthFrameData,        // Depth frame data and size of depth frame
-					depthWidth * depthHeight, framePoints); // Output CameraSpacePoint array and size
-
+					depthWidth * depthHeight, (CameraSpacePoint*)f.xyz.getRawDataPointer()); // Output CameraSpacePoint array and size
+				depthFrames.publish();
 			}
 
 			if (processColor->boolValue())
@@ -60,7 +60,6 @@ public:
   libfreenect2::Freenect2 freenect2;
   libfreenect2::Freenect2Device *dev = 0;
   libfreenect2::PacketPipeline *pipeline = 0;
-  Vector3D<float> points[K2_DEPTH_WIDTH*K2_DEPTH_HEIGHT];
   
   uint32 timeAtLastInit = 0;
   String serial;
@@ -71,7 +70,6 @@ public:
 	// Body reader
 	IDepthFrameReader* depthReader;
 	IColorFrameReader* colorReader;
-	CameraSpacePoint* framePoints;    // Maps depth pixels to 3d coordinates
 #endif //FREENECT
 #endif
 
@@ -92,7 +90,8 @@ public:
 	int colorWidth;
 	int colorHeight;
 
-	SpinLock frameLock;
+	TripleBuffer<PointsFrame<float>> depthFrames; //3d coordinates of the depth pixels, filled by the capture thread
+	CloudPool cloudPool;
 	Image colorImage;
 
 	bool newFrameAvailable;
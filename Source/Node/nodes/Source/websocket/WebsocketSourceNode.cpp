@@ -9,7 +9,8 @@
 */
 
 WebsocketSourceNode::WebsocketSourceNode(var params) :
-	Node(getTypeString(), Node::SOURCE, params)
+	Node(getTypeString(), Node::SOURCE, params),
+	clusterCloudPool(64)
 {
 	for (int i = 0; i < 3; i++) outClouds.add(addSlot("Out Cloud " + String(i + 1), false, POINTCLOUD));
 	outClusters = addSlot("Out Clusters", false, CLUSTERS);
@@ -63,7 +64,7 @@ void WebsocketSourceNode::processInternal()
 	while (cit.next())
 	{
 		if (i >= outClouds.size()) break;
-		sendPointCloud(outClouds[i], cit.getValue());
+		sendPointCloud(outClouds[i++], cit.getValue());
 		if (curTime - idTimeMap[cit.getKey()] > 1) cloudsToRemove.add(cit.getKey());
 	}
 
@@ -105,81 +106,252 @@ void WebsocketSourceNode::messageReceived(const String& message)
 
 void WebsocketSourceNode::dataReceived(const MemoryBlock& data)
 {
-	MemoryInputStream is(data, false);
+	if (data.getSize() == 0) return;
 
-	int type = is.readByte();
+	//decoded straight from the message into new pooled clouds that are only published once complete,
+	//processInternal keeps its own references to the previous ones and never sees a frame being written
+	const uint8* d = (const uint8*)data.getData();
+	const uint8* end = d + data.getSize();
+
+	int type = (int8)*d++;
 
 	if (type == CLEAR)
 	{
 		clouds.clear();
 		clusters.clear();
 		idTimeMap.clear();
+		remoteClusterStates.clear();
+		return;
 	}
 
-	int id = is.readInt();
-
 	float curTime = Time::getMillisecondCounter() / 1000.0f;
 
+	if (type == StreamProtocol::ClusterBatchType)
+	{
+		readClusterBatch(d, end, curTime);
+		return;
+	}
+
+	if (type == StreamProtocol::ClusterDeltaType)
+	{
+		readClusterDeltas(d, end, curTime);
+		return;
+	}
+
+	if (end - d < 4) return;
+	int id;
+	d = StreamProtocol::readInt(d, id);
+
 	switch (type)
 	{
 	case CLOUD:
+	case StreamProtocol::CloudQuantizedType:
 	{
-		if (!clouds.contains(id)) clouds.set(id, CloudPtr(new Cloud()));
-		CloudPtr cloud = clouds[id];
+		bool quantized = type == StreamProtocol::CloudQuantizedType;
+		float step = StreamProtocol::quantizedStep;
+		if (quantized)
+		{
+			if (end - d < 4) return;
+			d = StreamProtocol::readFloat(d, step);
+		}
 
-		idTimeMap.set(id, curTime);
+		int numPoints = (int)((end - d) / StreamProtocol::getPointSize(quantized));
+		CloudPtr cloud = cloudPool.getCloud(numPoints, 1);
+		StreamProtocol::readPoints(d, cloud->points.data(), numPoints, quantized, step);
 
-		int numPoints = is.getNumBytesRemaining() / 12;
+		clouds.set(id, cloud);
+		idTimeMap.set(id, curTime);
 
-		cloud->resize(numPoints);
-		for (int i = 0; i < numPoints; i++)
-		{
-			float tx = is.readFloat();
-			float ty = is.readFloat();
-			float tz = is.readFloat();
-			cloud->at(i) = PPoint(tx,ty,tz);
-		}
-		NNLOG("Received cloud " << id << ", num points : " << (int)cloud->size());
+		NNLOG("Received cloud " << id << ", num points : " << numPoints);
 	}
 	break;
 
 	case CLUSTER:
 	{
-		if (!clusters.contains(id)) clusters.set(id, ClusterPtr(new Cluster(id, CloudPtr(new Cloud()))));
-		ClusterPtr cluster = clusters[id];
+		if (end - d < StreamProtocol::clusterHeaderSize - 4) return;
+
+		ClusterPtr cluster = createClusterUpdate(id);
+
+		int state;
+		d = StreamProtocol::readInt(d, state);
+		cluster->state = (Cluster::State)state;
+		d = readClusterVectors(d, *cluster);
+
+		int numPoints = (int)((end - d) / StreamProtocol::getPointSize(false));
+		CloudPtr cloud = clusterCloudPool.getCloud(numPoints, 1);
+		StreamProtocol::readPoints(d, cloud->points.data(), numPoints, false);
+		cluster->setCloud(cloud);
+		cluster->lastUpdateTime = curTime;
+
+		clusters.set(id, cluster);
+
+		NNLOG("Received cluster " << cluster->id << ", state : " << (int)cluster->state << ", num points : " << numPoints);
+	}
+	break;
+	}
+}
+
+ClusterPtr WebsocketSourceNode::createClusterUpdate(int id)
+{
+	//a new object for each update, the previous one may be in use down the chain. Values that are not streamed are kept
+	ClusterPtr previous = clusters.contains(id) ? clusters[id] : nullptr;
+	if (previous != nullptr) return ClusterPtr(new Cluster(*previous));
+	return ClusterPtr(new Cluster(id, nullptr));
+}
+
+void WebsocketSourceNode::setClusterLeaving(int id)
+{
+	ClusterPtr cluster = createClusterUpdate(id);
+	cluster->state = Cluster::WILL_LEAVE;
+	clusters.set(id, cluster);
+}
+
+const uint8* WebsocketSourceNode::readClusterVectors(const uint8* d, Cluster& cluster)
+{
+	for (auto v : { &cluster.centroid, &cluster.velocity, &cluster.boundingBoxMin, &cluster.boundingBoxMax })
+	{
+		d = StreamProtocol::readFloat(d, v->x);
+		d = StreamProtocol::readFloat(d, v->y);
+		d = StreamProtocol::readFloat(d, v->z);
+	}
+	return d;
+}
+
+void WebsocketSourceNode::readClusterBatch(const uint8* d, const uint8* end, float curTime)
+{
+	if (end - d < 9) return;
+
+	bool quantized = *d++ != 0;
+	float step;
+	int numClusters;
+	d = StreamProtocol::readFloat(d, step);
+	d = StreamProtocol::readInt(d, numClusters);
+
+	int pointSize = StreamProtocol::getPointSize(quantized);
+
+	for (int i = 0; i < numClusters; i++)
+	{
+		if (end - d < StreamProtocol::clusterHeaderSize + 4) break;
 
-		cluster->state = (Cluster::State)is.readInt();
+		int id, state, numPoints;
+		d = StreamProtocol::readInt(d, id);
+		d = StreamProtocol::readInt(d, state);
 
-		cluster->centroid.x = is.readFloat();
-		cluster->centroid.y = is.readFloat();
-		cluster->centroid.z = is.readFloat();
-		cluster->velocity.x = is.readFloat();
-		cluster->velocity.y = is.readFloat();
-		cluster->velocity.z = is.readFloat();
-		cluster->boundingBoxMin.x = is.readFloat();
-		cluster->boundingBoxMin.y = is.readFloat();
-		cluster->boundingBoxMin.z = is.readFloat();
-		cluster->boundingBoxMax.x = is.readFloat();
-		cluster->boundingBoxMax.y = is.readFloat();
-		cluster->boundingBoxMax.z = is.readFloat();
+		ClusterPtr cluster = createClusterUpdate(id);
+		cluster->state = (Cluster::State)state;
+		d = readClusterVectors(d, *cluster);
 
+		d = StreamProtocol::readInt(d, numPoints);
+		if (numPoints < 0 || (end - d) < (int64)numPoints * pointSize) break;
+
+		CloudPtr cloud = clusterCloudPool.getCloud(numPoints, 1);
+		d = StreamProtocol::readPoints(d, cloud->points.data(), numPoints, quantized, step);
+		cluster->setCloud(cloud);
 		cluster->lastUpdateTime = curTime;
 
-		NNLOG("Received cluster " << cluster->id << ", state : " << (int)cluster->state << ", num points : " << (int)cluster->cloud->size());
+		clusters.set(id, cluster);
+	}
+}
+
+void WebsocketSourceNode::readClusterDeltas(const uint8* d, const uint8* end, float curTime)
+{
+	if (end - d < StreamProtocol::deltaHeaderSize) return; //empty keyframes are valid, they clear the scene
 
-		int numPoints = is.getNumBytesRemaining() / 12;
-		cluster->cloud->resize(numPoints);
-		for (int i = 0; i < numPoints; i++)
+	int version = *d++;
+	if (version != StreamProtocol::deltaVersion)
+	{
+		NLOGWARNING(niceName, "Unsupported cluster delta protocol version " << version);
+		return;
+	}
+
+	bool keyframe = *d++ != 0;
+	float step;
+	int numRecords;
+	d = StreamProtocol::readFloat(d, step);
+	d = StreamProtocol::readInt(d, numRecords);
+
+	if (keyframe) remoteClusterStates.clear();
+
+	Array<int> receivedIDs;
+	bool isDesynchronized = false;
+
+	for (int i = 0; i < numRecords && d < end; i++)
+	{
+		int kind = *d++;
+		int id;
+		d = StreamProtocol::readVarint(d, end, id);
+
+		if (kind == StreamProtocol::RecordLeft)
 		{
-			float x = is.readFloat();
-			float y = is.readFloat();
-			float z = is.readFloat();
-			cluster->cloud->at(i) = PPoint(x, y, z);
+			remoteClusterStates.remove(id);
+			if (clusters.contains(id)) setClusterLeaving(id);
+			continue;
 		}
 
+		StreamProtocol::ClusterState s;
+		if (kind == StreamProtocol::RecordFull)
+		{
+			d = StreamProtocol::readVarint(d, end, s.state);
+			for (int v = 0; v < StreamProtocol::ClusterState::numValues; v++) d = StreamProtocol::readVarint(d, end, s.values[v]);
+		}
+		else
+		{
+			//a delta on a cluster we don't know, still parsed to get to the next record
+			if (!remoteClusterStates.contains(id)) isDesynchronized = true;
+			else s = remoteClusterStates[id];
+
+			int fields = d < end ? *d++ : 0;
+			if (fields & StreamProtocol::StateChanged) d = StreamProtocol::readVarint(d, end, s.state);
+			for (auto f : { StreamProtocol::CentroidChanged, StreamProtocol::VelocityChanged, StreamProtocol::BoxChanged })
+			{
+				if ((fields & f) == 0) continue;
+				Range<int> r = StreamProtocol::getFieldRange(f);
+				for (int v = r.getStart(); v < r.getEnd(); v++)
+				{
+					int delta;
+					d = StreamProtocol::readVarint(d, end, delta);
+					s.values[v] += delta;
+				}
+			}
+		}
+
+		int numPoints;
+		d = StreamProtocol::readVarint(d, end, numPoints);
+		if (numPoints < 0 || (end - d) < (int64)numPoints * StreamProtocol::getPointSize(true)) break;
+
+		if (kind == StreamProtocol::RecordUpdate && !remoteClusterStates.contains(id))
+		{
+			d += numPoints * StreamProtocol::getPointSize(true);
+			continue;
+		}
+
+		remoteClusterStates.set(id, s);
+		receivedIDs.add(id);
+
+		ClusterPtr cluster = createClusterUpdate(id);
+		s.applyTo(*cluster, step);
+		CloudPtr cloud = clusterCloudPool.getCloud(numPoints, 1);
+		d = StreamProtocol::readPoints(d, cloud->points.data(), numPoints, true, step);
+		cluster->setCloud(cloud);
+		cluster->lastUpdateTime = curTime;
+
+		clusters.set(id, cluster);
 	}
-	break;
+
+	//a keyframe holds all the clusters, the others have left
+	if (keyframe)
+	{
+		Array<int> leftIDs;
+		HashMap<int, ClusterPtr, DefaultHashFunctions, CriticalSection>::Iterator it(clusters);
+		while (it.next())
+		{
+			if (!receivedIDs.contains(it.getKey())) leftIDs.add(it.getKey());
+		}
+
+		for (auto& id : leftIDs) setClusterLeaving(id);
 	}
+
+	if (isDesynchronized && client != nullptr) client->send("{\"type\":\"keyframe\"}");
 }
 
 void WebsocketSourceNode::connectionClosed(int status, const String& reason)
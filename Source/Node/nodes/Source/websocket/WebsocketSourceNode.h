@@ -32,17 +32,14 @@ public:
 	HashMap<int, ClusterPtr, DefaultHashFunctions, CriticalSection> clusters;
 	HashMap<int, float, DefaultHashFunctions, CriticalSection> idTimeMap;
 
+	CloudPool cloudPool;
+	CloudPool clusterCloudPool;
+
+	HashMap<int, StreamProtocol::ClusterState> remoteClusterStates; //last values received in delta protocol, only used on the websocket thread
+
 	std::unique_ptr<SimpleWebSocketClient> client;
 
-	enum ActionType { CLEAR = -1, CLOUD = 0, CLUSTER = 1 };
-	enum DataType {
-		CloudType = 0,
-		ClusterType = 1,
-		DebugBoxType = 2,
-		DebugPointType = 3,
-		DebugLineType = 4,
-		DebugPlaneType = 5
-	};
+	enum ActionType { CLEAR = -1, CLOUD = StreamProtocol::CloudType, CLUSTER = StreamProtocol::ClusterType };
 
 	void setupClient();
 	void processInternal() override;
@@ -50,6 +47,11 @@ public:
 	virtual void connectionOpened() override;
 	virtual void messageReceived(const String& message) override;
 	virtual void dataReceived(const MemoryBlock& data) override;
+	ClusterPtr createClusterUpdate(int id);
+	void setClusterLeaving(int id); //publishes a new object, the previous one may be in use down the chain
+	const uint8* readClusterVectors(const uint8* data, Cluster& cluster);
+	void readClusterBatch(const uint8* data, const uint8* end, float curTime);
+	void readClusterDeltas(const uint8* data, const uint8* end, float curTime);
 	virtual void connectionClosed(int status, const String& reason) override;
 	virtual void connectionError(const String& message) override;
 